@@ -0,0 +1,132 @@
+#pragma once
+#include "lock_free_queue.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+namespace mlts
+{
+
+// messages handled by one actor per turn before it yields its worker to other actors
+constexpr inline std::size_t k_actor_throughput = 64;
+
+// an actor owns a lock_free_queue mailbox and has no thread: the first message sent to an idle
+// actor schedules it on the pool, it then handles up to its throughput quota per turn and goes
+// idle again once its mailbox is empty. receive never runs concurrently with itself.
+// a turn may still touch the actor right after idle() turned true, shut the pool down before
+// destroying actors it may run
+template<typename Message, typename Pool = thread_pool<>>
+class actor
+{
+public:
+    using message_type = Message;
+
+    explicit actor(Pool& pool, std::size_t throughput = k_actor_throughput) : m_pool(pool), m_throughput(throughput)
+    {
+    }
+
+    virtual ~actor() = default;
+
+    actor(const actor&) = delete;
+    actor& operator=(const actor&) = delete;
+    actor(actor&&) noexcept = delete;
+    actor& operator=(actor&&) noexcept = delete;
+
+    // any thread, one mailbox push; the sender that wakes an idle actor also pushes its turn.
+    // false when the pool is closed and refused that turn: the message stays queued and the actor
+    // idle, the next send to an open pool schedules both
+    template<typename... Args>
+    bool send(Args&&... args)
+    {
+        m_mailbox.emplace(std::forward<Args>(args)...);
+        // pairs with the fence in go_idle, either this load sees the actor scheduled or the
+        // actor sees this message after it cleared the flag
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (not m_scheduled.load(std::memory_order_relaxed) &&
+            not m_scheduled.exchange(true, std::memory_order_acquire))
+        {
+            return schedule();
+        }
+        return true;
+    }
+
+    // no turn is scheduled, racing sends may change that right away
+    bool idle() const noexcept
+    {
+        return not m_scheduled.load(std::memory_order_acquire);
+    }
+
+    std::size_t mailbox_size() const noexcept
+    {
+        return m_mailbox.size_approx();
+    }
+
+protected:
+    virtual void receive(Message& msg) = 0;
+
+    Pool& pool() noexcept
+    {
+        return m_pool;
+    }
+
+private:
+    // a refused turn leaves the actor idle, otherwise nothing would ever schedule it again
+    bool schedule()
+    {
+        if (m_pool.push_func([this]() { turn(); })) [[likely]]
+        {
+            return true;
+        }
+        m_scheduled.store(false, std::memory_order_release);
+        return false;
+    }
+
+    void turn()
+    {
+        std::size_t count{0};
+        try
+        {
+            for (; count < m_throughput; ++count)
+            {
+                auto msg = m_mailbox.pop();
+                if (not msg)
+                {
+                    break;
+                }
+                receive(*msg);
+            }
+        }
+        catch (...)
+        {
+            // the message that threw is gone, the rest is still handled
+            go_idle();
+            throw;
+        }
+        if (count == m_throughput)
+        {
+            // quota used up, go to the back of the pool queue and stay scheduled
+            schedule();
+            return;
+        }
+        go_idle();
+    }
+
+    void go_idle()
+    {
+        m_scheduled.store(false, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (not m_mailbox.empty() && not m_scheduled.exchange(true, std::memory_order_acquire))
+        {
+            schedule();
+        }
+    }
+
+    lock_free_queue<Message> m_mailbox{};
+    std::atomic<bool> m_scheduled{false};
+    Pool& m_pool;
+    const std::size_t m_throughput;
+};
+
+} // namespace mlts
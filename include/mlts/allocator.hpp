@@ -1,8 +1,11 @@
 #pragma once
 #include "define_type.hpp"
+#include "detail/config.hpp"
 #include "detail/mp_sc_circular_fifo_allocator_buffer.hpp"
+#include "lock_free_stack.hpp"
 #include <assert.h>
 #include <atomic>
+#include <memory>
 #include <stdexcept>
 
 namespace mlts
@@ -118,4 +121,158 @@ private:
 };
 
 
+// node cache for multiple producers, single consumer queues: the consumer keeps freed nodes in a
+// local list and returns them to the producers one chain at a time through a lock_free_stack, every
+// producer thread keeps a thread local magazine filled from that chain, so steady-state
+// allocate/deallocate never reach Alloc
+template<typename T, size_t BatchSize = 64, typename Alloc = std::allocator<T>>
+struct mp_sc_recycle_allocator
+{
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+
+    struct free_node
+    {
+        lock_free_stack_hook m_hook{};
+    };
+    using free_stack = lock_free_stack<free_node, &free_node::m_hook>;
+
+    mp_sc_recycle_allocator() = default;
+
+    ~mp_sc_recycle_allocator()
+    {
+        release(m_local);
+        release(m_return.pop_all());
+    }
+
+    mp_sc_recycle_allocator(const mp_sc_recycle_allocator&) = delete;
+    mp_sc_recycle_allocator& operator=(const mp_sc_recycle_allocator&) = delete;
+    mp_sc_recycle_allocator(mp_sc_recycle_allocator&&) noexcept = delete;
+    mp_sc_recycle_allocator& operator=(mp_sc_recycle_allocator&&) noexcept = delete;
+
+    // called by producers
+    T* allocate(size_type n)
+    {
+        if (n != 1) [[unlikely]]
+        {
+            return Alloc{}.allocate(n);
+        }
+        auto& mag = magazine();
+        if (mag.m_head == nullptr) [[unlikely]]
+        {
+            mag.m_head = m_return.pop_all();
+            if (mag.m_head == nullptr)
+            {
+                return Alloc{}.allocate(1);
+            }
+        }
+        free_node* node = mag.m_head;
+        mag.m_head = free_stack::next(*node);
+        std::destroy_at(node);
+        return reinterpret_cast<T*>(node);
+    }
+
+    // called by the consumer
+    void deallocate(T* p, size_type n)
+    {
+        if (n != 1) [[unlikely]]
+        {
+            Alloc{}.deallocate(p, n);
+            return;
+        }
+        stash(p);
+        hand_back();
+    }
+
+    // called by the consumer, takes count nodes at once, next(p) returns the node after p
+    // and is called before p is reused
+    template<typename Next>
+    void deallocate_chain(T* first, size_type count, Next&& next)
+    {
+        for (size_type i = 0; i < count; ++i)
+        {
+            T* const following = next(first);
+            stash(first);
+            first = following;
+        }
+        hand_back();
+    }
+
+private:
+    void stash(T* p) noexcept
+    {
+        free_node* node = std::construct_at(reinterpret_cast<free_node*>(p));
+        if (m_local)
+        {
+            free_stack::link(*node, *m_local);
+        }
+        else
+        {
+            m_local_last = node;
+        }
+        m_local = node;
+        ++m_local_size;
+    }
+
+    void hand_back() noexcept
+    {
+        if (m_local_size < BatchSize) [[likely]]
+        {
+            return;
+        }
+
+        // one chain in flight is enough, producers take it whole
+        if (m_return.empty())
+        {
+            m_return.push_chain(*m_local, *m_local_last);
+            m_local = nullptr;
+            m_local_size = 0;
+        }
+        else if (m_local_size >= BatchSize * 2)
+        {
+            // producers are not short of nodes, give the surplus back
+            release(m_local);
+            m_local = nullptr;
+            m_local_size = 0;
+        }
+    }
+
+    struct thread_magazine
+    {
+        ~thread_magazine()
+        {
+            release(m_head);
+        }
+
+        free_node* m_head{nullptr};
+    };
+
+    static_assert(sizeof(T) >= sizeof(free_node) && alignof(T) >= alignof(free_node), "node too small to recycle");
+    static_assert(std::allocator_traits<Alloc>::is_always_equal::value, "recycled nodes are shared between instances");
+
+    static thread_magazine& magazine() noexcept
+    {
+        static thread_local thread_magazine s_magazine{};
+        return s_magazine;
+    }
+
+    static void release(free_node* node) noexcept
+    {
+        while (node)
+        {
+            free_node* next = free_stack::next(*node);
+            std::destroy_at(node);
+            Alloc{}.deallocate(reinterpret_cast<T*>(node), 1);
+            node = next;
+        }
+    }
+
+    free_stack m_return{};
+    alignas(detail::k_machine_cache_line) free_node* m_local{nullptr};
+    free_node* m_local_last{nullptr};
+    size_t m_local_size{0};
+};
+
 } // namespace mlts
\ No newline at end of file
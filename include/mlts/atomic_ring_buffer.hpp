@@ -1,5 +1,10 @@
 #pragma once
+#include "detail/config.hpp"
+#include "detail/queue_stats.hpp"
+#include <algorithm>
 #include <atomic>
+#include <cstdlib>
+#include <memory>
 #include <vector>
 #include <optional>
 #include <span>
@@ -23,8 +28,8 @@ public:
 
     ~atomic_ring_buffer()
     {
-        auto in = m_in & m_mask;
-        auto out = m_out & m_mask;
+        auto in = m_in.load(std::memory_order_relaxed) & m_mask;
+        auto out = m_out.load(std::memory_order_relaxed) & m_mask;
         for (; out != in; out = (out + 1) & m_mask)
         {
             std::destroy_at(&m_buf[out]);
@@ -69,10 +74,9 @@ public:
 
     size_t put(T* values, size_t len)
     {
-        auto in = m_in.load(std::memory_order_acquire);
+        auto in = m_in.load(std::memory_order_relaxed);
         auto out = m_out.load(std::memory_order_acquire);
         len = std::min(len, capacity() - in + out);
-        m_in.store(len + in, std::memory_order_release);
 
         size_t l = std::min(len, capacity() - (in & m_mask));
         for (size_t i = 0; i < l; ++i)
@@ -83,32 +87,41 @@ public:
         size_t rl = len - l;
         for (size_t i = 0; i < rl; ++i)
         {
-            m_buf[i] = std::move(values[i + l]);
+            std::construct_at<T>(&m_buf[i], std::move(values[i + l]));
         }
 
-
+        // publish only once the values are constructed
+        m_in.store(len + in, std::memory_order_release);
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(len + in - out);
+        }
         return len;
     }
 
     size_t get(T* values, size_t len)
     {
         auto in = m_in.load(std::memory_order_acquire);
-        auto out = m_out.load(std::memory_order_acquire);
+        auto out = m_out.load(std::memory_order_relaxed);
 
         len = std::min(len, in - out);
-        m_out.store(len + out, std::memory_order_release);
 
         size_t l = std::min(len, capacity() - (out & m_mask));
         for (size_t i = 0; i < l; ++i)
         {
             values[i] = std::move(m_buf[i + (out & m_mask)]);
+            std::destroy_at(&m_buf[i + (out & m_mask)]);
         }
 
         size_t rl = len - l;
         for (size_t i = 0; i < rl; ++i)
         {
             values[l + i] = std::move(m_buf[i]);
+            std::destroy_at(&m_buf[i]);
         }
+
+        // hand the slots back only once the values are moved out
+        m_out.store(len + out, std::memory_order_release);
         return len;
     }
 
@@ -129,13 +142,26 @@ public:
 
     bool empty() const
     {
-        return !empty_len();
+        return exist_len() == 0;
+    }
+
+    // any thread, may be stale by the time it returns
+    size_t size_approx() const noexcept
+    {
+        auto out = m_out.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_in.load(std::memory_order_relaxed), out);
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_in.load(std::memory_order_relaxed), m_out.load(std::memory_order_relaxed), m_high_water.value()};
     }
 
 private:
-    std::atomic<size_t> m_in{};
-    std::atomic<size_t> m_out{};
-    const size_t m_mask;
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_in{};
+    detail::queue_high_water m_high_water{};
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_out{};
+    alignas(detail::k_machine_cache_line) const size_t m_mask;
     T* m_buf{};
     static constexpr inline size_t esize = sizeof(T);
 };
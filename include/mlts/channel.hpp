@@ -0,0 +1,718 @@
+#pragma once
+#include "define_type.hpp"
+#include "detail/config.hpp"
+#include "detail/event_count.hpp"
+#include "detail/thread_random.hpp"
+#include "lock_free_circular_queue.hpp"
+#include "lock_free_segment_queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+
+namespace mlts
+{
+
+enum class channel_result : int
+{
+    ok,
+    // full (send) or empty (recv)
+    would_block,
+    // closed, a recv only reports it once everything sent before close was received
+    closed,
+};
+
+// channel kinds
+struct channel_unbuffered
+{
+};
+
+template<std::uint32_t Capacity = DynamicSize32>
+struct channel_bounded
+{
+};
+
+struct channel_unbounded
+{
+};
+
+namespace detail
+{
+
+// every select parked on any channel waits here and rechecks its cases when woken
+inline event_count& channel_select_event() noexcept
+{
+    static event_count s_event{};
+    return s_event;
+}
+
+class channel_core
+{
+public:
+    channel_core() = default;
+    channel_core(const channel_core&) = delete;
+    channel_core& operator=(const channel_core&) = delete;
+
+    bool closed() const noexcept
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+    // a select is parked on this channel, notifications are forwarded to channel_select_event
+    void select_arm([[maybe_unused]] bool recv) noexcept
+    {
+        m_selectors.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void select_disarm([[maybe_unused]] bool recv) noexcept
+    {
+        m_selectors.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+protected:
+    static constexpr inline std::uint32_t k_spin = 64;
+
+    void set_closed() noexcept
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_recv_event.notify_all();
+        m_send_event.notify_all();
+        notify_selectors();
+    }
+
+    void notify_receivers() noexcept
+    {
+        m_recv_event.notify_one();
+        notify_selectors();
+    }
+
+    void notify_senders() noexcept
+    {
+        m_send_event.notify_one();
+        notify_selectors();
+    }
+
+    void notify_all_senders() noexcept
+    {
+        m_send_event.notify_all();
+        notify_selectors();
+    }
+
+    // spins, then parks on event until op() stops returning would_block
+    template<typename F>
+    static channel_result wait_on(event_count& event, F&& op)
+    {
+        for (std::uint32_t spin = 0; spin < k_spin; ++spin)
+        {
+            if (auto r = op(); r != channel_result::would_block)
+            {
+                return r;
+            }
+        }
+        while (1)
+        {
+            auto key = event.prepare_wait();
+            if (auto r = op(); r != channel_result::would_block)
+            {
+                event.cancel_wait();
+                return r;
+            }
+            event.wait(key);
+        }
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= k_spin)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<bool> m_closed{false};
+    std::atomic<std::uint32_t> m_selectors{0};
+    event_count m_recv_event{};
+    event_count m_send_event{};
+
+private:
+    void notify_selectors() noexcept
+    {
+        // the event_count notify before this fenced, a select arming after this load rechecks
+        // its cases after arming and sees what was just published
+        if (m_selectors.load(std::memory_order_relaxed) != 0)
+        {
+            channel_select_event().notify_all();
+        }
+    }
+};
+
+// a channel over a queue with try_emplace/try_pop (bounded) or emplace/pop (unbounded)
+template<typename T, typename Queue>
+class buffered_channel : public channel_core
+{
+public:
+    using value_type = T;
+
+    template<typename... Args>
+    explicit buffered_channel(Args&&... args) : m_queue(std::forward<Args>(args)...)
+    {
+    }
+
+    channel_result try_send(const T& value)
+    {
+        return try_send_impl(value);
+    }
+
+    // value is left untouched unless it was sent
+    channel_result try_send(T&& value)
+    {
+        return try_send_impl(std::move(value));
+    }
+
+    // waits while full, false when closed
+    bool send(const T& value)
+    {
+        return wait_on(m_send_event, [&]() { return try_send_impl(value); }) == channel_result::ok;
+    }
+
+    bool send(T&& value)
+    {
+        return wait_on(m_send_event, [&]() { return try_send_impl(std::move(value)); }) == channel_result::ok;
+    }
+
+    channel_result try_recv(T& value)
+    {
+        if (queue_pop(value))
+        {
+            return channel_result::ok;
+        }
+        if (not closed())
+        {
+            return channel_result::would_block;
+        }
+        // closed after the last send, that send is visible now
+        return queue_pop(value) ? channel_result::ok : channel_result::closed;
+    }
+
+    // waits while empty, false once closed and drained
+    bool recv(T& value)
+    {
+        return wait_on(m_recv_event, [&]() { return try_recv(value); }) == channel_result::ok;
+    }
+
+    std::optional<T> recv()
+    {
+        T value{};
+        if (recv(value))
+        {
+            return value;
+        }
+        return {};
+    }
+
+    // like Go only senders close, once every send returned; receivers drain what is left
+    void close() noexcept
+    {
+        set_closed();
+    }
+
+    std::size_t size_approx() const noexcept
+    {
+        return m_queue.size_approx();
+    }
+
+private:
+    static constexpr inline bool k_bounded = requires(Queue& q, T& v) { q.try_pop(v); };
+
+    template<typename U>
+    channel_result try_send_impl(U&& value)
+    {
+        if (closed())
+        {
+            return channel_result::closed;
+        }
+        if constexpr (k_bounded)
+        {
+            if (not m_queue.try_emplace(std::forward<U>(value)))
+            {
+                return channel_result::would_block;
+            }
+        }
+        else
+        {
+            m_queue.emplace(std::forward<U>(value));
+        }
+        notify_receivers();
+        return channel_result::ok;
+    }
+
+    bool queue_pop(T& value)
+    {
+        if constexpr (k_bounded)
+        {
+            if (not m_queue.try_pop(value))
+            {
+                return false;
+            }
+            notify_senders();
+            return true;
+        }
+        else
+        {
+            return m_queue.pop(value);
+        }
+    }
+
+    Queue m_queue;
+};
+
+} // namespace detail
+
+// Go style channels. send/recv park the calling thread on an event_count after a short spin,
+// a blocked thread sleeps without holding a lock; thread_pool tasks should use the try_ forms
+// (or select's try_select) and resubmit themselves instead of blocking a worker
+template<typename T, typename Kind = channel_unbuffered>
+class channel;
+
+// bounded multiple producers, multiple consumers channel on lock_free_circular_queue
+template<typename T, std::uint32_t Capacity>
+class channel<T, channel_bounded<Capacity>> : public detail::buffered_channel<T, lock_free_circular_queue<T, Capacity>>
+{
+    using base = detail::buffered_channel<T, lock_free_circular_queue<T, Capacity>>;
+
+public:
+    channel()
+        requires(Capacity != DynamicSize32)
+    = default;
+
+    // rounded up to a power of two
+    explicit channel(std::uint32_t capacity)
+        requires(Capacity == DynamicSize32)
+        : base(capacity)
+    {
+    }
+};
+
+// unbounded multiple producers, multiple consumers channel on lock_free_segment_queue,
+// send never waits
+template<typename T>
+class channel<T, channel_unbounded> : public detail::buffered_channel<T, lock_free_segment_queue<T>>
+{
+public:
+    channel() = default;
+};
+
+// rendezvous channel: a send only completes once a receiver took the value. one sender at a time
+// parks its value in the slot, the others wait for the slot. try_send only succeeds while a
+// receiver is parked in recv or in a select
+template<typename T>
+class channel<T, channel_unbuffered> : public detail::channel_core
+{
+    enum slot_state : std::uint32_t
+    {
+        k_free,
+        k_writing,
+        k_full,
+        k_reading,
+        k_taken,
+    };
+
+public:
+    using value_type = T;
+
+    channel() = default;
+
+    channel_result try_send(const T& value)
+    {
+        return try_send_impl(value);
+    }
+
+    // value is left untouched unless it was sent
+    channel_result try_send(T&& value)
+    {
+        return try_send_impl(std::move(value));
+    }
+
+    // waits for a receiver, false when closed before one took the value
+    bool send(const T& value)
+    {
+        return send_impl(value);
+    }
+
+    bool send(T&& value)
+    {
+        return send_impl(std::move(value));
+    }
+
+    channel_result try_recv(T& value)
+    {
+        if (take(value))
+        {
+            return channel_result::ok;
+        }
+        if (not closed())
+        {
+            return channel_result::would_block;
+        }
+        return take(value) ? channel_result::ok : channel_result::closed;
+    }
+
+    bool recv(T& value)
+    {
+        add_receiver();
+        auto r = wait_on(m_recv_event, [&]() { return try_recv(value); });
+        m_receivers.fetch_sub(1, std::memory_order_relaxed);
+        return r == channel_result::ok;
+    }
+
+    std::optional<T> recv()
+    {
+        T value{};
+        if (recv(value))
+        {
+            return value;
+        }
+        return {};
+    }
+
+    // like Go only senders close; a sender still waiting for a receiver gets its value back
+    void close() noexcept
+    {
+        set_closed();
+    }
+
+    // a select waiting to receive counts as a parked receiver for try_send
+    void select_arm(bool recv) noexcept
+    {
+        channel_core::select_arm(recv);
+        if (recv)
+        {
+            add_receiver();
+        }
+    }
+
+    void select_disarm(bool recv) noexcept
+    {
+        if (recv)
+        {
+            m_receivers.fetch_sub(1, std::memory_order_relaxed);
+        }
+        channel_core::select_disarm(recv);
+    }
+
+private:
+    // wakes selects that wait to send, their try_send only offers to a parked receiver
+    void add_receiver() noexcept
+    {
+        m_receivers.fetch_add(1, std::memory_order_seq_cst);
+        notify_all_senders();
+    }
+
+    T* slot() noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(m_storage));
+    }
+
+    template<typename U>
+    channel_result try_send_impl(U&& value)
+    {
+        if (closed())
+        {
+            return channel_result::closed;
+        }
+        if (m_receivers.load(std::memory_order_seq_cst) == 0 || not place(std::forward<U>(value)))
+        {
+            return channel_result::would_block;
+        }
+        // wait for the pickup while a receiver is still parked, take the value back otherwise
+        for (std::uint32_t spin = 0;; ++spin)
+        {
+            if (m_state.load(std::memory_order_acquire) == k_taken)
+            {
+                release_slot();
+                return channel_result::ok;
+            }
+            if (m_receivers.load(std::memory_order_relaxed) == 0 || closed())
+            {
+                if (withdraw(std::forward<U>(value)))
+                {
+                    return closed() ? channel_result::closed : channel_result::would_block;
+                }
+                return channel_result::ok;
+            }
+            backoff(spin);
+        }
+    }
+
+    template<typename U>
+    bool send_impl(U&& value)
+    {
+        auto r = wait_on(m_send_event, [&]() {
+            if (closed())
+            {
+                return channel_result::closed;
+            }
+            return place(std::forward<U>(value)) ? channel_result::ok : channel_result::would_block;
+        });
+        if (r == channel_result::closed)
+        {
+            return false;
+        }
+        r = wait_on(m_send_event, [this]() {
+            if (m_state.load(std::memory_order_acquire) == k_taken)
+            {
+                return channel_result::ok;
+            }
+            return closed() ? channel_result::closed : channel_result::would_block;
+        });
+        if (r == channel_result::ok)
+        {
+            release_slot();
+            return true;
+        }
+        // closed while waiting, unless a receiver was faster
+        return not withdraw(std::forward<U>(value));
+    }
+
+    // moves or copies value into the free slot, value stays untouched when the slot is busy
+    template<typename U>
+    bool place(U&& value)
+    {
+        std::uint32_t expected = k_free;
+        if (not m_state.compare_exchange_strong(expected, k_writing, std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+        {
+            return false;
+        }
+        try
+        {
+            std::construct_at(slot(), std::forward<U>(value));
+        }
+        catch (...)
+        {
+            m_state.store(k_free, std::memory_order_release);
+            throw;
+        }
+        m_state.store(k_full, std::memory_order_release);
+        notify_receivers();
+        return true;
+    }
+
+    // true when the value came back, false when a receiver took it first
+    template<typename U>
+    bool withdraw(U&& value)
+    {
+        std::uint32_t expected = k_full;
+        if (m_state.compare_exchange_strong(expected, k_writing, std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+        {
+            if constexpr (not std::is_const_v<std::remove_reference_t<U>>)
+            {
+                value = std::move(*slot());
+            }
+            std::destroy_at(slot());
+            release_slot();
+            return true;
+        }
+        for (std::uint32_t spin = 0; m_state.load(std::memory_order_acquire) != k_taken; ++spin)
+        {
+            backoff(spin);
+        }
+        release_slot();
+        return false;
+    }
+
+    bool take(T& value)
+    {
+        std::uint32_t expected = k_full;
+        if (not m_state.compare_exchange_strong(expected, k_reading, std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+        {
+            return false;
+        }
+        value = std::move(*slot());
+        std::destroy_at(slot());
+        m_state.store(k_taken, std::memory_order_release);
+        // the owner of the value and the senders waiting for the slot share the event
+        notify_all_senders();
+        return true;
+    }
+
+    void release_slot() noexcept
+    {
+        m_state.store(k_free, std::memory_order_release);
+        notify_all_senders();
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<std::uint32_t> m_state{k_free};
+    std::atomic<std::uint32_t> m_receivers{0};
+    alignas(T) unsigned char m_storage[sizeof(T)];
+};
+
+// select case receiving from a channel, f(std::optional<T>) gets nullopt when the channel is closed
+template<typename Channel, typename F>
+class channel_recv_case
+{
+public:
+    using value_type = typename Channel::value_type;
+
+    channel_recv_case(Channel& ch, F f) : m_channel(ch), m_f(std::move(f))
+    {
+    }
+
+    bool try_fire()
+    {
+        value_type value{};
+        auto r = m_channel.try_recv(value);
+        if (r == channel_result::would_block)
+        {
+            return false;
+        }
+        m_f(r == channel_result::ok ? std::optional<value_type>(std::move(value)) : std::nullopt);
+        return true;
+    }
+
+    void arm() noexcept
+    {
+        m_channel.select_arm(true);
+    }
+
+    void disarm() noexcept
+    {
+        m_channel.select_disarm(true);
+    }
+
+private:
+    Channel& m_channel;
+    F m_f;
+};
+
+// select case sending to a channel, f(bool) gets false when the channel is closed
+template<typename Channel, typename F>
+class channel_send_case
+{
+public:
+    using value_type = typename Channel::value_type;
+
+    template<typename U>
+    channel_send_case(Channel& ch, U&& value, F f) : m_channel(ch), m_value(std::forward<U>(value)), m_f(std::move(f))
+    {
+    }
+
+    bool try_fire()
+    {
+        auto r = m_channel.try_send(std::move(m_value));
+        if (r == channel_result::would_block)
+        {
+            return false;
+        }
+        m_f(r == channel_result::ok);
+        return true;
+    }
+
+    void arm() noexcept
+    {
+        m_channel.select_arm(false);
+    }
+
+    void disarm() noexcept
+    {
+        m_channel.select_disarm(false);
+    }
+
+private:
+    Channel& m_channel;
+    value_type m_value;
+    F m_f;
+};
+
+template<typename Channel, typename F>
+auto on_recv(Channel& ch, F&& f)
+{
+    return channel_recv_case<Channel, std::decay_t<F>>(ch, std::forward<F>(f));
+}
+
+template<typename Channel, typename U, typename F>
+auto on_send(Channel& ch, U&& value, F&& f)
+{
+    return channel_send_case<Channel, std::decay_t<F>>(ch, std::forward<U>(value), std::forward<F>(f));
+}
+
+namespace detail
+{
+
+// tries the cases once, starting at start and wrapping around
+template<typename... Cases, std::size_t... I>
+std::optional<std::size_t> select_try_each(std::size_t start, std::index_sequence<I...>, Cases&... cases)
+{
+    constexpr std::size_t size = sizeof...(Cases);
+    for (std::size_t k = 0; k < size; ++k)
+    {
+        std::size_t idx = start + k < size ? start + k : start + k - size;
+        bool fired{false};
+        ((void)(idx == I && (fired = cases.try_fire())), ...);
+        if (fired)
+        {
+            return idx;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace detail
+
+// runs the first ready case and returns its index, nullopt when none is ready.
+// cases are tried from a random start so a busy channel cannot starve the others
+template<typename... Cases>
+std::optional<std::size_t> try_select(Cases&&... cases)
+{
+    static_assert(sizeof...(Cases) > 0, "select needs a case");
+    auto start = detail::thread_random_below(sizeof...(Cases));
+    return detail::select_try_each(start, std::index_sequence_for<Cases...>{}, cases...);
+}
+
+// waits until one case is ready, runs it and returns its index; exactly one case runs
+template<typename... Cases>
+std::size_t select(Cases&&... cases)
+{
+    static_assert(sizeof...(Cases) > 0, "select needs a case");
+    auto start = detail::thread_random_below(sizeof...(Cases));
+    constexpr auto seq = std::index_sequence_for<Cases...>{};
+    if (auto idx = detail::select_try_each(start, seq, cases...))
+    {
+        return *idx;
+    }
+    auto& event = detail::channel_select_event();
+    std::optional<std::size_t> idx{};
+    (cases.arm(), ...);
+    while (1)
+    {
+        auto key = event.prepare_wait();
+        try
+        {
+            idx = detail::select_try_each(start, seq, cases...);
+        }
+        catch (...)
+        {
+            event.cancel_wait();
+            (cases.disarm(), ...);
+            throw;
+        }
+        if (idx)
+        {
+            event.cancel_wait();
+            break;
+        }
+        event.wait(key);
+    }
+    (cases.disarm(), ...);
+    return *idx;
+}
+
+} // namespace mlts
@@ -0,0 +1,524 @@
+#pragma once
+#include "detail/config.hpp"
+#include "epoch_domain.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace mlts
+{
+
+// open addressing hash map of node pointers with linear probing.
+// readers never lock: they probe under an epoch guard and see a key's node or not.
+// writers lock the stripe of their key, so writers of different stripes only meet on the CAS
+// that claims a free slot. nodes are immutable, an assign swaps in a new node and erase leaves
+// a tombstone; the old node is retired to the epoch domain.
+// a resize publishes a second table while holding every stripe, after that each write moves a
+// chunk of slots over before its own operation and the old table is retired once all slots moved
+template<typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class concurrent_hash_map
+{
+    struct node
+    {
+        std::size_t m_hash;
+        Key m_key;
+        Value m_value;
+    };
+
+    struct table
+    {
+        table(std::size_t capacity, std::size_t used)
+            : m_slots(std::make_unique<std::atomic<node*>[]>(capacity)), m_mask(capacity - 1), m_used(used)
+        {
+        }
+
+        std::unique_ptr<std::atomic<node*>[]> m_slots;
+        const std::size_t m_mask;
+        // slots taken from empty, plus the nodes a running migration still brings in
+        alignas(detail::k_machine_cache_line) std::atomic<std::size_t> m_used;
+        alignas(detail::k_machine_cache_line) std::atomic<table*> m_next{nullptr};
+        std::atomic<std::size_t> m_migrate_cursor{0};
+        std::atomic<std::size_t> m_migrated{0};
+    };
+
+    struct alignas(detail::k_machine_cache_line) stripe
+    {
+        std::mutex m_mu{};
+        std::atomic<std::size_t> m_size{0};
+    };
+
+    enum class write_status
+    {
+        done,
+        retry,
+        grow,
+    };
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+
+    explicit concurrent_hash_map(std::size_t capacity = k_min_capacity,
+                                 epoch_domain& domain = epoch_domain::global())
+        : m_domain(domain), m_table(new table(std::bit_ceil(std::max(capacity, k_min_capacity)), 0))
+    {
+        static_assert(std::atomic<node*>::is_always_lock_free, "not support lock free");
+    }
+
+    // no other thread may use the map, nodes already retired are freed by the domain
+    ~concurrent_hash_map()
+    {
+        table* t = m_table.load(std::memory_order_relaxed);
+        table* next = t->m_next.load(std::memory_order_relaxed);
+        free_table(t);
+        if (next)
+        {
+            free_table(next);
+        }
+    }
+
+    concurrent_hash_map(const concurrent_hash_map&) = delete;
+    concurrent_hash_map& operator=(const concurrent_hash_map&) = delete;
+    concurrent_hash_map(concurrent_hash_map&&) noexcept = delete;
+    concurrent_hash_map& operator=(concurrent_hash_map&&) noexcept = delete;
+
+    // calls f(const Value&) with the value found, the value stays valid for the call only
+    template<typename F>
+    bool visit(const Key& key, F&& f) const
+    {
+        const auto h = hash_of(key);
+        epoch_domain::guard g(m_domain);
+        // a key inserted during a resize may only be in the next table
+        for (table* t = m_table.load(std::memory_order_acquire); t; t = t->m_next.load(std::memory_order_seq_cst))
+        {
+            if (node* n = find_node(*t, key, h))
+            {
+                std::invoke(f, std::as_const(n->m_value));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::optional<Value> find(const Key& key) const
+    {
+        std::optional<Value> ret{};
+        visit(key, [&ret](const Value& v) { ret.emplace(v); });
+        return ret;
+    }
+
+    bool contains(const Key& key) const
+    {
+        return visit(key, [](const Value&) {});
+    }
+
+    // false and nothing stored when the key is already there
+    bool insert(Key key, Value value)
+    {
+        return put(std::move(key), std::move(value), false);
+    }
+
+    // true when the key was inserted, false when its value was replaced
+    bool insert_or_assign(Key key, Value value)
+    {
+        return put(std::move(key), std::move(value), true);
+    }
+
+    bool erase(const Key& key)
+    {
+        const auto h = hash_of(key);
+        return write(key, h, [this, &key, h](table& t, stripe& s, bool& erased) {
+            for (std::size_t i = 0; i <= t.m_mask; ++i)
+            {
+                auto& slot = t.m_slots[(h + i) & t.m_mask];
+                node* p = slot.load(std::memory_order_acquire);
+                if (p == nullptr)
+                {
+                    return write_status::done;
+                }
+                if (is_moved(p))
+                {
+                    return write_status::retry;
+                }
+                if (is_node(p) && p->m_hash == h && m_equal(p->m_key, key))
+                {
+                    slot.store(tombstone(), std::memory_order_release);
+                    s.m_size.store(s.m_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+                    m_domain.retire(p);
+                    erased = true;
+                    return write_status::done;
+                }
+            }
+            return write_status::done;
+        });
+    }
+
+    // sum of the stripe counts, exact only while no thread writes
+    std::size_t size() const noexcept
+    {
+        std::size_t size{0};
+        for (const auto& s : m_stripes)
+        {
+            size += s.m_size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    // slots of the newest table
+    std::size_t capacity() const
+    {
+        epoch_domain::guard g(m_domain);
+        table* t = m_table.load(std::memory_order_acquire);
+        table* next = t->m_next.load(std::memory_order_acquire);
+        return (next ? next : t)->m_mask + 1;
+    }
+
+private:
+    static constexpr inline std::size_t k_min_capacity = 256;
+    static constexpr inline std::size_t k_stripe_count = 64;
+    static constexpr inline std::size_t k_migrate_chunk = 64;
+
+    static node* tombstone() noexcept
+    {
+        return reinterpret_cast<node*>(std::uintptr_t{1});
+    }
+
+    // a migrated node or tombstone, probes go on past it
+    static node* moved() noexcept
+    {
+        return reinterpret_cast<node*>(std::uintptr_t{2});
+    }
+
+    // a slot that was still empty when migrated, it ends probes like an empty one: no key of the
+    // old table can sit behind it, and none is inserted there anymore
+    static node* moved_empty() noexcept
+    {
+        return reinterpret_cast<node*>(std::uintptr_t{3});
+    }
+
+    static bool is_moved(node* p) noexcept
+    {
+        return p == moved() || p == moved_empty();
+    }
+
+    static bool is_node(node* p) noexcept
+    {
+        return reinterpret_cast<std::uintptr_t>(p) > 3;
+    }
+
+    std::size_t hash_of(const Key& key) const
+    {
+        // std::hash of integers is the identity, mix so the slot and stripe bits both vary
+        std::uint64_t h = m_hash(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+
+    stripe& stripe_of(std::size_t h) noexcept
+    {
+        return m_stripes[(h >> 48) & (k_stripe_count - 1)];
+    }
+
+    node* find_node(const table& t, const Key& key, std::size_t h) const
+    {
+        for (std::size_t i = 0; i <= t.m_mask; ++i)
+        {
+            node* p = t.m_slots[(h + i) & t.m_mask].load(std::memory_order_acquire);
+            if (p == nullptr || p == moved_empty())
+            {
+                return nullptr;
+            }
+            if (is_node(p) && p->m_hash == h && m_equal(p->m_key, key))
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    bool put(Key&& key, Value&& value, bool assign)
+    {
+        const auto h = hash_of(key);
+        // built before the stripe is locked, freed again when the key is already there
+        std::unique_ptr<node> fresh(new node{h, std::move(key), std::move(value)});
+        return write(fresh->m_key, h, [this, &fresh, h, assign](table& t, stripe& s, bool& inserted) {
+            std::size_t reuse = t.m_mask + 1;
+            std::size_t i = 0;
+            for (; i <= t.m_mask; ++i)
+            {
+                auto& slot = t.m_slots[(h + i) & t.m_mask];
+                node* p = slot.load(std::memory_order_acquire);
+                if (p == nullptr)
+                {
+                    break;
+                }
+                if (is_moved(p))
+                {
+                    return write_status::retry;
+                }
+                if (p == tombstone())
+                {
+                    reuse = std::min(reuse, i);
+                    continue;
+                }
+                if (p->m_hash == h && m_equal(p->m_key, fresh->m_key))
+                {
+                    if (assign)
+                    {
+                        slot.store(fresh.release(), std::memory_order_release);
+                        m_domain.retire(p);
+                    }
+                    return write_status::done;
+                }
+            }
+            if (reuse > t.m_mask)
+            {
+                if (i > t.m_mask || not has_room(t))
+                {
+                    return write_status::grow;
+                }
+                reuse = i;
+            }
+            // the slot is free but writers of other stripes and the migration may take it first
+            auto& slot = t.m_slots[(h + reuse) & t.m_mask];
+            node* expected = slot.load(std::memory_order_relaxed);
+            if ((expected != nullptr && expected != tombstone()) ||
+                not slot.compare_exchange_strong(expected, fresh.get(), std::memory_order_release,
+                                                 std::memory_order_relaxed))
+            {
+                return write_status::retry;
+            }
+            fresh.release();
+            if (expected == nullptr)
+            {
+                t.m_used.fetch_add(1, std::memory_order_relaxed);
+            }
+            s.m_size.store(s.m_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            inserted = true;
+            return write_status::done;
+        });
+    }
+
+    // runs op(table, stripe, result) on the newest table with the key's stripe locked
+    template<typename Op>
+    bool write(const Key& key, std::size_t h, Op&& op)
+    {
+        auto& s = stripe_of(h);
+        while (1)
+        {
+            epoch_domain::guard g(m_domain);
+            help_migrate(*m_table.load(std::memory_order_acquire));
+            bool result{false};
+            write_status status{write_status::retry};
+            {
+                std::scoped_lock lk(s.m_mu);
+                table* t = m_table.load(std::memory_order_acquire);
+                table* next = t->m_next.load(std::memory_order_acquire);
+                // the key moves ahead of its chunk so the operation sees it in the next table
+                if (next == nullptr || migrate_key(*t, *next, key, h))
+                {
+                    status = op(next ? *next : *t, s, result);
+                }
+            }
+            if (status == write_status::done)
+            {
+                return result;
+            }
+            table* t = m_table.load(std::memory_order_acquire);
+            if (t->m_next.load(std::memory_order_acquire))
+            {
+                finish_migration(*t);
+            }
+            else if (status == write_status::grow)
+            {
+                start_resize(t);
+            }
+        }
+    }
+
+    // writers claim at most one slot each after this check, so even a full house of stripes
+    // leaves a quarter of the table empty and probes short
+    static bool has_room(const table& t) noexcept
+    {
+        auto capacity = t.m_mask + 1;
+        return t.m_used.load(std::memory_order_relaxed) + k_stripe_count < capacity - capacity / 4;
+    }
+
+    void start_resize(table* t)
+    {
+        // with every stripe held no writer is inside: the live count is exact and every writer
+        // sees the next table once it gets its stripe back
+        std::vector<std::unique_lock<std::mutex>> locks{};
+        locks.reserve(k_stripe_count);
+        for (auto& s : m_stripes)
+        {
+            locks.emplace_back(s.m_mu);
+        }
+        if (m_table.load(std::memory_order_acquire) != t || t->m_next.load(std::memory_order_acquire) != nullptr)
+        {
+            return;
+        }
+        auto live = size();
+        auto capacity = std::bit_ceil(std::max(k_min_capacity, 2 * (live + k_stripe_count)));
+        t->m_next.store(new table(capacity, live), std::memory_order_seq_cst);
+    }
+
+    // moves one chunk of t into its next table, false when there was nothing left to claim
+    bool help_migrate(table& t)
+    {
+        table* next = t.m_next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        const auto capacity = t.m_mask + 1;
+        auto begin = t.m_migrate_cursor.fetch_add(k_migrate_chunk, std::memory_order_relaxed);
+        if (begin >= capacity)
+        {
+            return false;
+        }
+        auto end = std::min(begin + k_migrate_chunk, capacity);
+        for (auto i = begin; i < end; ++i)
+        {
+            migrate_slot(t, *next, i);
+        }
+        if (t.m_migrated.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == capacity)
+        {
+            m_table.store(next, std::memory_order_seq_cst);
+            m_domain.retire(&t);
+        }
+        return true;
+    }
+
+    void finish_migration(table& t)
+    {
+        while (help_migrate(t))
+        {
+        }
+        // chunks claimed by other threads, they only wait on single stripes
+        while (m_table.load(std::memory_order_acquire) == &t)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void migrate_slot(table& t, table& next, std::size_t i)
+    {
+        auto& slot = t.m_slots[i];
+        while (1)
+        {
+            node* p = slot.load(std::memory_order_acquire);
+            if (is_moved(p))
+            {
+                return;
+            }
+            if (not is_node(p))
+            {
+                // writers stopped claiming slots here when the next table was published
+                if (slot.compare_exchange_weak(p, p == nullptr ? moved_empty() : moved(), std::memory_order_acq_rel,
+                                               std::memory_order_relaxed))
+                {
+                    return;
+                }
+                continue;
+            }
+            // a node only changes under its stripe, and the guard keeps p from being reused
+            std::scoped_lock lk(stripe_of(p->m_hash).m_mu);
+            if (slot.load(std::memory_order_acquire) == p)
+            {
+                place(next, p);
+                slot.store(moved(), std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    // stripe of key held
+    bool migrate_key(table& t, table& next, const Key& key, std::size_t h)
+    {
+        for (std::size_t i = 0; i <= t.m_mask; ++i)
+        {
+            auto& slot = t.m_slots[(h + i) & t.m_mask];
+            node* p = slot.load(std::memory_order_acquire);
+            if (p == nullptr || p == moved_empty())
+            {
+                return true;
+            }
+            if (is_node(p) && p->m_hash == h && m_equal(p->m_key, key))
+            {
+                if (not place(next, p))
+                {
+                    return false;
+                }
+                slot.store(moved(), std::memory_order_release);
+                return true;
+            }
+        }
+        return true;
+    }
+
+    // puts a migrated node into the first free slot, its room was reserved by start_resize.
+    // false when next is itself being migrated
+    bool place(table& next, node* n)
+    {
+        for (std::size_t i = 0; i <= next.m_mask;)
+        {
+            auto& slot = next.m_slots[(n->m_hash + i) & next.m_mask];
+            node* p = slot.load(std::memory_order_acquire);
+            if (is_moved(p))
+            {
+                return false;
+            }
+            if (is_node(p))
+            {
+                ++i;
+                continue;
+            }
+            if (slot.compare_exchange_strong(p, n, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void free_table(table* t)
+    {
+        for (std::size_t i = 0; i <= t->m_mask; ++i)
+        {
+            node* p = t->m_slots[i].load(std::memory_order_relaxed);
+            if (is_node(p))
+            {
+                delete p;
+            }
+        }
+        delete t;
+    }
+
+    epoch_domain& m_domain;
+    [[no_unique_address]] Hash m_hash{};
+    [[no_unique_address]] KeyEqual m_equal{};
+    alignas(detail::k_machine_cache_line) std::atomic<table*> m_table;
+    stripe m_stripes[k_stripe_count]{};
+};
+
+} // namespace mlts
@@ -1,10 +1,23 @@
 #pragma once
+#include <cstddef>
 #include <new>
 
+#if defined(_MSC_VER)
+#define MLTS_COLD __declspec(noinline)
+#else
+#define MLTS_COLD [[gnu::cold, gnu::noinline]]
+#endif
+
+// 1 to track queue high-water marks, costs a load of the consumer side counter per push
+#if !defined(MLTS_QUEUE_TELEMETRY)
+#define MLTS_QUEUE_TELEMETRY 0
+#endif
+
 namespace mlts
 {
 namespace detail
 {
     constexpr auto k_machine_cache_line = std::hardware_constructive_interference_size;
+    constexpr std::size_t k_huge_page_size = 2 * 1024 * 1024;
 }
 } // namespace mlts
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// eventcount: lets a consumer park on a condition of a lock free structure without lost wakeups.
+// waiter: key = prepare_wait(), recheck the condition, then cancel_wait() or wait(key).
+// notifier: publish, then notify_*(), which costs a fence and a load unless someone is parked
+class event_count
+{
+public:
+    using key_type = std::uint64_t;
+
+    event_count() = default;
+    event_count(const event_count&) = delete;
+    event_count& operator=(const event_count&) = delete;
+    event_count(event_count&&) noexcept = delete;
+    event_count& operator=(event_count&&) noexcept = delete;
+
+    key_type prepare_wait() noexcept
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        // pairs with the fence in notify, the recheck after this cannot miss a publication
+        // whose notify saw no waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_acquire);
+    }
+
+    void cancel_wait() noexcept
+    {
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wait(key_type key)
+    {
+        {
+            std::unique_lock lk(m_mu);
+            m_cv.wait(lk, [this, key]() { return m_epoch.load(std::memory_order_relaxed) != key; });
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // false on timeout
+    template<typename Clock, typename Duration>
+    bool wait_until(key_type key, const std::chrono::time_point<Clock, Duration>& deadline)
+    {
+        bool notified{};
+        {
+            std::unique_lock lk(m_mu);
+            notified = m_cv.wait_until(lk, deadline,
+                                       [this, key]() { return m_epoch.load(std::memory_order_relaxed) != key; });
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return notified;
+    }
+
+    void notify_one() noexcept
+    {
+        if (has_waiters())
+        {
+            advance();
+            m_cv.notify_one();
+        }
+    }
+
+    void notify_all() noexcept
+    {
+        if (has_waiters())
+        {
+            advance();
+            m_cv.notify_all();
+        }
+    }
+
+private:
+    bool has_waiters() const noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_waiters.load(std::memory_order_relaxed) != 0;
+    }
+
+    void advance() noexcept
+    {
+        // under the mutex so a waiter between its predicate check and its sleep cannot miss it
+        std::scoped_lock lk(m_mu);
+        m_epoch.fetch_add(1, std::memory_order_release);
+    }
+
+    std::atomic<std::uint32_t> m_waiters{0};
+    std::atomic<key_type> m_epoch{0};
+    std::mutex m_mu{};
+    std::condition_variable m_cv{};
+};
+
+// stands in for event_count where nobody ever parks, notifying compiles to nothing
+struct null_event_count
+{
+    void notify_one() noexcept
+    {
+    }
+
+    void notify_all() noexcept
+    {
+    }
+};
+
+} // namespace detail
+} // namespace mlts
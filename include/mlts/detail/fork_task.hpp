@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// a spawned child living in its parent's frame, whoever runs it publishes m_done last
+struct fork_task
+{
+    void (*m_invoke)(void*){nullptr};
+    void* m_func{nullptr};
+    std::exception_ptr m_exception{};
+    std::atomic<bool> m_done{false};
+
+    template<typename F>
+    void bind(F& f) noexcept
+    {
+        m_func = std::addressof(f);
+        m_invoke = +[](void* func) { std::invoke(*static_cast<F*>(func)); };
+    }
+
+    void run() noexcept
+    {
+        try
+        {
+            m_invoke(m_func);
+        }
+        catch (...)
+        {
+            m_exception = std::current_exception();
+        }
+        m_done.store(true, std::memory_order_release);
+    }
+
+    bool is_done() const noexcept
+    {
+        return m_done.load(std::memory_order_acquire);
+    }
+};
+
+} // namespace detail
+} // namespace mlts
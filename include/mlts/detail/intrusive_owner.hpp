@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// the element a hook member belongs to
+template<typename T, typename H, H T::*Hook>
+T* intrusive_owner(H* hook) noexcept
+{
+    static const std::ptrdiff_t offset = []() {
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* p = reinterpret_cast<T*>(storage);
+        return reinterpret_cast<unsigned char*>(&(p->*Hook)) - reinterpret_cast<unsigned char*>(p);
+    }();
+    return reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(hook) - offset);
+}
+
+} // namespace detail
+} // namespace mlts
@@ -1,8 +1,16 @@
+#pragma once
 #include "../define_type.hpp"
+#include "config.hpp"
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <memory>
+#include <new>
+#include <stdexcept>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 namespace mlts
 {
@@ -22,28 +30,98 @@ struct queue_circular_buffer : public std::array<T, Size>
     }
 };
 
+// capacity chosen at runtime and rounded up to a power of two, so indexing stays a single mask;
+// buffers of at least one huge page are huge page aligned and, on linux, backed by transparent huge pages
 template<typename T>
 struct queue_circular_buffer<T, mlts::DynamicSize32>
 {
+    explicit queue_circular_buffer(std::uint32_t capacity = 1024)
+    {
+        allocate(capacity);
+    }
 
-    constexpr queue_circular_buffer(std::uint32_t capacity = 1024)
-        : m_buffer(std::make_unique_for_overwrite<T[]>(capacity)), m_capacity(capacity), m_mask(capacity - 1)
+    ~queue_circular_buffer()
     {
-        assert(std::has_single_bit(capacity) && "not support");
-        static_assert(false, "not support");
+        release();
     }
 
-    constexpr void resize(size_t size)
+    queue_circular_buffer(const queue_circular_buffer&) = delete;
+    queue_circular_buffer& operator=(const queue_circular_buffer&) = delete;
+    queue_circular_buffer(queue_circular_buffer&&) noexcept = delete;
+    queue_circular_buffer& operator=(queue_circular_buffer&&) noexcept = delete;
+
+    // drops the current elements, only valid while nobody uses the buffer
+    void resize(std::uint32_t capacity)
     {
-        std::uint32_t capacity = m_capacity * 2;
+        release();
+        allocate(capacity);
     }
-    constexpr std::uint32_t mask() const noexcept
+
+    T& operator[](std::size_t index) noexcept
+    {
+        return m_buffer[index];
+    }
+
+    const T& operator[](std::size_t index) const noexcept
+    {
+        return m_buffer[index];
+    }
+
+    std::uint32_t size() const noexcept
+    {
+        return m_capacity;
+    }
+
+    std::uint32_t mask() const noexcept
     {
         return m_mask;
     }
-    std::unique_ptr<T[]> m_buffer;
-    std::uint32_t m_capacity;
-    std::uint32_t m_mask;
+
+private:
+    void allocate(std::uint32_t capacity)
+    {
+        if (capacity > (std::uint32_t{1} << 31)) [[unlikely]]
+        {
+            throw std::length_error("queue capacity above 2^31");
+        }
+        capacity = std::bit_ceil(std::max<std::uint32_t>(capacity, 2));
+        std::size_t bytes = sizeof(T) * capacity;
+        std::size_t align = std::max<std::size_t>(alignof(T), k_machine_cache_line);
+        if (bytes >= k_huge_page_size)
+        {
+            align = k_huge_page_size;
+            bytes = (bytes + k_huge_page_size - 1) & ~(k_huge_page_size - 1);
+        }
+
+        void* p = ::operator new(bytes, std::align_val_t{align});
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (align == k_huge_page_size)
+        {
+            ::madvise(p, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        m_buffer = static_cast<T*>(p);
+        std::uninitialized_default_construct_n(m_buffer, capacity);
+        m_capacity = capacity;
+        m_mask = capacity - 1;
+        m_align = align;
+    }
+
+    void release() noexcept
+    {
+        if (m_buffer == nullptr)
+        {
+            return;
+        }
+        std::destroy_n(m_buffer, m_capacity);
+        ::operator delete(static_cast<void*>(m_buffer), std::align_val_t{m_align});
+        m_buffer = nullptr;
+    }
+
+    T* m_buffer{nullptr};
+    std::uint32_t m_capacity{0};
+    std::uint32_t m_mask{0};
+    std::size_t m_align{0};
 };
 
 } // namespace detail
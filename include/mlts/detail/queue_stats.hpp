@@ -0,0 +1,63 @@
+#pragma once
+#include "config.hpp"
+#include <atomic>
+#include <cstddef>
+
+
+namespace mlts
+{
+
+// monotonic counters of a queue, sample twice and divide by the interval for rates
+struct queue_stats
+{
+    std::size_t m_enqueued{0};
+    std::size_t m_dequeued{0};
+    // 0 unless MLTS_QUEUE_TELEMETRY
+    std::size_t m_high_water{0};
+};
+
+namespace detail
+{
+
+// enqueued - dequeued read without ordering, never negative
+inline std::size_t queue_size_approx(std::size_t enqueued, std::size_t dequeued) noexcept
+{
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+// largest occupancy seen by producers, an empty type when telemetry is compiled out
+class queue_high_water
+{
+public:
+    void update([[maybe_unused]] std::size_t size) noexcept
+    {
+#if MLTS_QUEUE_TELEMETRY
+        auto cur = m_value.load(std::memory_order_relaxed);
+        while (size > cur && not m_value.compare_exchange_weak(cur, size, std::memory_order_relaxed))
+        {
+        }
+#endif
+    }
+
+    std::size_t value() const noexcept
+    {
+#if MLTS_QUEUE_TELEMETRY
+        return m_value.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    static constexpr bool enabled() noexcept
+    {
+        return MLTS_QUEUE_TELEMETRY != 0;
+    }
+
+private:
+#if MLTS_QUEUE_TELEMETRY
+    std::atomic<std::size_t> m_value{0};
+#endif
+};
+
+} // namespace detail
+} // namespace mlts
@@ -0,0 +1,451 @@
+#pragma once
+#include "config.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// an object unlinked from a shared structure, waiting until no thread can still read it
+struct retired_ptr
+{
+    void reclaim() const noexcept
+    {
+        m_deleter(m_ptr);
+    }
+
+    void* m_ptr;
+    void (*m_deleter)(void*);
+    // epoch_domain only, the global epoch when it was retired
+    std::uint64_t m_epoch;
+};
+
+template<typename T>
+void delete_retired(void* p)
+{
+    delete static_cast<T*>(p);
+}
+
+// frees every entry pred accepts, deleters may retire again so the list is trimmed first.
+// runs inside noexcept reclamation passes: without memory for the copy nothing is freed and the
+// next pass retries
+template<typename Pred>
+std::size_t reclaim_if(std::vector<retired_ptr>& list, Pred&& pred) noexcept
+{
+    auto it = std::partition(list.begin(), list.end(), [&pred](const retired_ptr& r) { return not pred(r); });
+    if (it == list.end())
+    {
+        return 0;
+    }
+    std::vector<retired_ptr> ready{};
+    try
+    {
+        ready.assign(it, list.end());
+    }
+    catch (const std::bad_alloc&)
+    {
+        return 0;
+    }
+    list.erase(it, list.end());
+    for (const auto& r : ready)
+    {
+        r.reclaim();
+    }
+    return ready.size();
+}
+
+// per thread records of a domain: append only, a record is reused after its thread exits and
+// only freed with the domain, so scans walk the list without locks
+template<typename Record>
+class reclaim_records
+{
+public:
+    reclaim_records() = default;
+    reclaim_records(const reclaim_records&) = delete;
+    reclaim_records& operator=(const reclaim_records&) = delete;
+
+    ~reclaim_records()
+    {
+        Record* r = m_head.load(std::memory_order_acquire);
+        while (r)
+        {
+            Record* next = r->m_next;
+            delete r;
+            r = next;
+        }
+    }
+
+    Record* acquire()
+    {
+        for (Record* r = m_head.load(std::memory_order_acquire); r; r = r->m_next)
+        {
+            bool expected{false};
+            if (not r->m_in_use.load(std::memory_order_relaxed) &&
+                r->m_in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return r;
+            }
+        }
+        Record* r = new Record{};
+        r->m_next = m_head.load(std::memory_order_relaxed);
+        while (not m_head.compare_exchange_weak(r->m_next, r, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return r;
+    }
+
+    template<typename F>
+    void for_each(F&& f) const
+    {
+        for (Record* r = m_head.load(std::memory_order_acquire); r; r = r->m_next)
+        {
+            f(*r);
+        }
+    }
+
+    std::size_t size() const noexcept
+    {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<Record*> m_head{nullptr};
+    std::atomic<std::size_t> m_size{0};
+};
+
+// retired objects left behind by exited threads, reclaimed by whichever thread gets the lock
+class reclaim_orphans
+{
+public:
+    void adopt(std::vector<retired_ptr>& list)
+    {
+        if (list.empty())
+        {
+            return;
+        }
+        std::scoped_lock lk(m_mu);
+        m_list.insert(m_list.end(), list.begin(), list.end());
+        list.clear();
+        m_empty.store(false, std::memory_order_release);
+    }
+
+    template<typename Pred>
+    void try_reclaim_if(Pred&& pred)
+    {
+        if (m_empty.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        std::unique_lock lk(m_mu, std::try_to_lock);
+        if (lk.owns_lock())
+        {
+            reclaim_if(m_list, pred);
+            m_empty.store(m_list.empty(), std::memory_order_release);
+        }
+    }
+
+    void reclaim_all()
+    {
+        std::scoped_lock lk(m_mu);
+        reclaim_if(m_list, [](const retired_ptr&) { return true; });
+        m_empty.store(true, std::memory_order_release);
+    }
+
+private:
+    std::mutex m_mu{};
+    std::vector<retired_ptr> m_list{};
+    std::atomic<bool> m_empty{true};
+};
+
+// ids are never reused, a thread local cache keyed by id cannot confuse a new domain with a dead one
+inline std::uint64_t next_reclaim_domain_id() noexcept
+{
+    static std::atomic<std::uint64_t> s_id{1};
+    return s_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+// a thread's membership in one domain, released when the thread exits or, once the domain is
+// destroyed, by the thread's next reclamation pass or new membership
+class reclaim_slot
+{
+public:
+    explicit reclaim_slot(std::uint64_t domain_id) noexcept : m_domain_id(domain_id)
+    {
+    }
+
+    virtual ~reclaim_slot() = default;
+
+    // frees whatever this thread retired that nobody can read any more
+    virtual void quiescent() noexcept = 0;
+
+    virtual std::size_t pending() const noexcept = 0;
+
+    // the domain is gone, the slot only keeps its state alive
+    virtual bool expired() const noexcept = 0;
+
+    std::uint64_t m_domain_id;
+};
+
+struct thread_reclaim
+{
+    ~thread_reclaim()
+    {
+        // slots hand their leftovers to their domains before anything else goes away
+        m_slots.clear();
+    }
+
+    reclaim_slot* find(std::uint64_t domain_id) noexcept
+    {
+        if (m_last && m_last->m_domain_id == domain_id) [[likely]]
+        {
+            return m_last;
+        }
+        for (auto& slot : m_slots)
+        {
+            if (slot->m_domain_id == domain_id)
+            {
+                m_last = slot.get();
+                return m_last;
+            }
+        }
+        return nullptr;
+    }
+
+    reclaim_slot* add(std::unique_ptr<reclaim_slot> slot)
+    {
+        // a slot may be inside quiescent() during a pass, it is pruned when the pass starts
+        if (not m_in_pass)
+        {
+            prune();
+        }
+        m_slots.push_back(std::move(slot));
+        m_last = m_slots.back().get();
+        return m_last;
+    }
+
+    // drops the slots of destroyed domains, the last one frees its domain's state whose deleters
+    // may add slots again, so the list is trimmed first
+    void prune()
+    {
+        auto it = std::partition(m_slots.begin(), m_slots.end(),
+                                 [](const std::unique_ptr<reclaim_slot>& slot) { return not slot->expired(); });
+        if (it == m_slots.end())
+        {
+            return;
+        }
+        std::vector<std::unique_ptr<reclaim_slot>> dead(std::make_move_iterator(it),
+                                                        std::make_move_iterator(m_slots.end()));
+        m_slots.erase(it, m_slots.end());
+        m_last = nullptr;
+    }
+
+    std::vector<std::unique_ptr<reclaim_slot>> m_slots{};
+    reclaim_slot* m_last{nullptr};
+    bool m_in_pass{false};
+    // retired by this thread over every domain and not freed yet, a hint recounted by every pass
+    std::size_t m_pending{0};
+    std::uint32_t m_calls{0};
+};
+
+inline thread_reclaim& this_thread_reclaim() noexcept
+{
+    static thread_local thread_reclaim s_reclaim{};
+    return s_reclaim;
+}
+
+// quiescent_state runs a reclamation pass every k_quiescent_period calls, or on every call once
+// k_reclaim_batch objects are pending; retire itself only reclaims past k_retire_limit
+constexpr inline std::uint32_t k_quiescent_period = 64;
+constexpr inline std::size_t k_reclaim_batch = 64;
+constexpr inline std::size_t k_retire_limit = 4096;
+
+// the part of a per thread record every domain shares, Derived adds what its readers publish
+template<typename Derived>
+struct reclaim_record_base
+{
+    std::atomic<bool> m_in_use{true};
+    Derived* m_next{nullptr};
+    std::vector<retired_ptr> m_retired{};
+};
+
+// the shared part of a domain's state, owned by the domain and by every thread slot.
+// destroying it frees everything still retired
+template<typename Record>
+struct reclaim_state_base
+{
+    reclaim_state_base() = default;
+    reclaim_state_base(const reclaim_state_base&) = delete;
+    reclaim_state_base& operator=(const reclaim_state_base&) = delete;
+
+    ~reclaim_state_base()
+    {
+        reclaim_all();
+    }
+
+    void reclaim_all() noexcept
+    {
+        m_records.for_each([](Record& r) { reclaim_if(r.m_retired, [](const retired_ptr&) { return true; }); });
+        m_orphans.reclaim_all();
+    }
+
+    alignas(k_machine_cache_line) reclaim_records<Record> m_records{};
+    reclaim_orphans m_orphans{};
+    // set once the domain is destroyed, its thread slots are pruned
+    std::atomic<bool> m_expired{false};
+};
+
+// a thread's slot in a domain of State: owns one record until the thread exits or prunes it.
+// State::reclaim(Record&) noexcept runs the pass, Record::reset() noexcept clears what the
+// record published before it is handed to another thread
+template<typename State, typename Record>
+class reclaim_domain_slot : public reclaim_slot
+{
+public:
+    using state_type = State;
+
+    reclaim_domain_slot(std::uint64_t domain_id, std::shared_ptr<State> s, thread_reclaim& owner)
+        : reclaim_slot(domain_id), m_state(std::move(s)), m_record(m_state->m_records.acquire()), m_owner(owner)
+    {
+    }
+
+    ~reclaim_domain_slot() override
+    {
+        m_state->m_orphans.adopt(m_record->m_retired);
+        m_record->reset();
+        m_record->m_in_use.store(false, std::memory_order_release);
+    }
+
+    void quiescent() noexcept override
+    {
+        m_state->reclaim(*m_record);
+    }
+
+    std::size_t pending() const noexcept override
+    {
+        return m_record->m_retired.size();
+    }
+
+    bool expired() const noexcept override
+    {
+        return m_state->m_expired.load(std::memory_order_acquire);
+    }
+
+protected:
+    void append(void* p, void (*deleter)(void*), std::uint64_t epoch)
+    {
+        m_record->m_retired.push_back({p, deleter, epoch});
+        ++m_owner.m_pending;
+        if (m_record->m_retired.size() >= k_retire_limit) [[unlikely]]
+        {
+            quiescent();
+        }
+    }
+
+    std::shared_ptr<State> m_state;
+    Record* m_record;
+    thread_reclaim& m_owner;
+};
+
+// the public face shared by the domains, Slot is a reclaim_domain_slot with retire(p, deleter)
+template<typename Slot>
+class reclaim_domain
+{
+public:
+    reclaim_domain(const reclaim_domain&) = delete;
+    reclaim_domain& operator=(const reclaim_domain&) = delete;
+    reclaim_domain(reclaim_domain&&) noexcept = delete;
+    reclaim_domain& operator=(reclaim_domain&&) noexcept = delete;
+
+    template<typename T>
+    void retire(T* p)
+    {
+        retire(p, &delete_retired<T>);
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        local()->retire(p, deleter);
+    }
+
+    // reclamation pass for the calling thread's retired objects
+    void quiescent()
+    {
+        local()->quiescent();
+    }
+
+    // objects the calling thread retired and are not freed yet
+    std::size_t pending()
+    {
+        return local()->pending();
+    }
+
+protected:
+    using state_type = typename Slot::state_type;
+
+    reclaim_domain() : m_state(std::make_shared<state_type>()), m_id(next_reclaim_domain_id())
+    {
+    }
+
+    // frees everything still retired, no thread may use the domain at that point
+    ~reclaim_domain()
+    {
+        m_state->reclaim_all();
+        m_state->m_expired.store(true, std::memory_order_release);
+    }
+
+    Slot* local()
+    {
+        auto& reclaim = this_thread_reclaim();
+        if (auto* s = reclaim.find(m_id)) [[likely]]
+        {
+            return static_cast<Slot*>(s);
+        }
+        return static_cast<Slot*>(reclaim.add(std::make_unique<Slot>(m_id, m_state, reclaim)));
+    }
+
+    // threads keep the state alive through their slots until they exit or see it expired
+    std::shared_ptr<state_type> m_state;
+    std::uint64_t m_id;
+};
+
+} // namespace detail
+
+// reclamation point for every domain the calling thread retired into, a no-op when nothing is
+// pending; thread_pool workers call it between tasks
+inline void quiescent_state() noexcept
+{
+    auto& reclaim = detail::this_thread_reclaim();
+    if (reclaim.m_pending == 0) [[likely]]
+    {
+        return;
+    }
+    if (++reclaim.m_calls < detail::k_quiescent_period && reclaim.m_pending < detail::k_reclaim_batch)
+    {
+        return;
+    }
+    reclaim.m_calls = 0;
+    reclaim.prune();
+    // deleters may retire into a new domain and grow the list, indices stay valid
+    reclaim.m_in_pass = true;
+    std::size_t pending{0};
+    for (std::size_t i = 0; i < reclaim.m_slots.size(); ++i)
+    {
+        reclaim.m_slots[i]->quiescent();
+        pending += reclaim.m_slots[i]->pending();
+    }
+    reclaim.m_in_pass = false;
+    reclaim.m_pending = pending;
+}
+
+} // namespace mlts
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// xorshift64*, one state per thread seeded from its address; cheap, not for anything but spreading load
+inline std::uint32_t thread_random() noexcept
+{
+    static thread_local std::uint64_t s_state = reinterpret_cast<std::uintptr_t>(&s_state) | 1;
+    s_state ^= s_state >> 12;
+    s_state ^= s_state << 25;
+    s_state ^= s_state >> 27;
+    return static_cast<std::uint32_t>((s_state * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+// uniform enough in [0, n) without a division
+inline std::size_t thread_random_below(std::size_t n) noexcept
+{
+    return static_cast<std::size_t>((std::uint64_t{thread_random()} * n) >> 32);
+}
+
+} // namespace detail
+} // namespace mlts
@@ -0,0 +1,146 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/reclaim.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+struct epoch_record : reclaim_record_base<epoch_record>
+{
+    // clears the guard before the record goes to another thread
+    void reset() noexcept
+    {
+        m_nest = 0;
+        m_state.store(0, std::memory_order_release);
+    }
+
+    // (epoch << 1) | 1 while inside a guard, 0 outside
+    alignas(k_machine_cache_line) std::atomic<std::uint64_t> m_state{0};
+    std::uint32_t m_nest{0};
+};
+
+struct epoch_state : reclaim_state_base<epoch_record>
+{
+    void advance() noexcept
+    {
+        auto epoch = m_epoch.load(std::memory_order_seq_cst);
+        bool blocked{false};
+        m_records.for_each([epoch, &blocked](const epoch_record& r) {
+            auto s = r.m_state.load(std::memory_order_seq_cst);
+            blocked = blocked || ((s & 1) && (s >> 1) != epoch);
+        });
+        if (not blocked)
+        {
+            m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+        }
+    }
+
+    void reclaim(epoch_record& r) noexcept
+    {
+        advance();
+        auto epoch = m_epoch.load(std::memory_order_acquire);
+        auto expired = [epoch](const retired_ptr& p) { return p.m_epoch + 2 <= epoch; };
+        reclaim_if(r.m_retired, expired);
+        m_orphans.try_reclaim_if(expired);
+    }
+
+    alignas(k_machine_cache_line) std::atomic<std::uint64_t> m_epoch{0};
+};
+
+class epoch_slot final : public reclaim_domain_slot<epoch_state, epoch_record>
+{
+public:
+    using reclaim_domain_slot::reclaim_domain_slot;
+
+    void enter() noexcept
+    {
+        if (m_record->m_nest++ != 0)
+        {
+            return;
+        }
+        // announce, then make sure the announcement is not already stale
+        auto epoch = m_state->m_epoch.load(std::memory_order_relaxed);
+        while (1)
+        {
+            m_record->m_state.store((epoch << 1) | 1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto now = m_state->m_epoch.load(std::memory_order_seq_cst);
+            if (now == epoch)
+            {
+                break;
+            }
+            epoch = now;
+        }
+    }
+
+    void exit() noexcept
+    {
+        if (--m_record->m_nest == 0)
+        {
+            m_record->m_state.store(0, std::memory_order_release);
+        }
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        append(p, deleter, m_state->m_epoch.load(std::memory_order_seq_cst));
+    }
+};
+
+} // namespace detail
+
+// epoch based reclamation: readers wrap every access in a guard, writers retire what they unlinked.
+// an object retired at epoch e is freed once the global epoch reached e + 2, which needs every
+// thread inside a guard to have seen e + 1. retire only appends to a thread local list, the
+// reclamation pass runs from quiescent_state() (thread_pool workers call it between tasks) or
+// when a list grows past detail::k_retire_limit.
+// destroying the domain frees everything still retired, no thread may use it at that point
+class epoch_domain : public detail::reclaim_domain<detail::epoch_slot>
+{
+public:
+    // keeps everything retired after it entered alive until it leaves, guards nest
+    class guard
+    {
+    public:
+        explicit guard(epoch_domain& domain) : m_slot(domain.local())
+        {
+            m_slot->enter();
+        }
+
+        ~guard()
+        {
+            m_slot->exit();
+        }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        guard(guard&&) noexcept = delete;
+        guard& operator=(guard&&) noexcept = delete;
+
+    private:
+        detail::epoch_slot* m_slot;
+    };
+
+    epoch_domain() = default;
+
+    static epoch_domain& global()
+    {
+        static epoch_domain s_domain{};
+        return s_domain;
+    }
+
+    std::uint64_t epoch() const noexcept
+    {
+        return m_state->m_epoch.load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace mlts
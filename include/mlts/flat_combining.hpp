@@ -0,0 +1,256 @@
+#pragma once
+#include "detail/config.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+
+namespace mlts
+{
+
+struct flat_combining_stats
+{
+    // times a thread took the combiner lock
+    std::size_t m_combines{0};
+    // operations applied, including the combiner's own
+    std::size_t m_operations{0};
+    // most operations applied under one lock hold
+    std::size_t m_max_batch{0};
+};
+
+// flat combining around a sequential structure: apply(f) publishes f in a slot, whichever thread
+// holds the combiner lock runs every published operation in one pass while the others spin on
+// their own operation. the structure stays in the combiner's cache and the lock changes hands
+// once per batch instead of once per operation. f runs on some thread, never concurrently with
+// another operation; exceptions are rethrown to the thread that applied f.
+// Slots bounds the threads that can publish at the same time, the others wait for a free slot
+template<typename T, std::size_t Slots = 64>
+class flat_combining
+{
+    struct operation
+    {
+        void (*m_run)(operation&, T&);
+        std::exception_ptr m_error{};
+        std::atomic<bool> m_done{false};
+    };
+
+    template<typename F, typename R>
+    struct bound_operation : operation
+    {
+        explicit bound_operation(F& f) : operation{&bound_operation::run}, m_f(f)
+        {
+        }
+
+        static void run(operation& op, T& value)
+        {
+            auto& self = static_cast<bound_operation&>(op);
+            try
+            {
+                if constexpr (std::is_void_v<R>)
+                {
+                    std::invoke(self.m_f, value);
+                }
+                else if constexpr (std::is_reference_v<R>)
+                {
+                    auto&& result = std::invoke(self.m_f, value);
+                    self.m_result.emplace(std::addressof(result));
+                }
+                else
+                {
+                    self.m_result.emplace(std::invoke(self.m_f, value));
+                }
+            }
+            catch (...)
+            {
+                self.m_error = std::current_exception();
+            }
+        }
+
+        // a reference result is kept as a pointer, optional cannot hold references
+        using stored_type = std::conditional_t<std::is_void_v<R>, char,
+                                               std::conditional_t<std::is_reference_v<R>, std::remove_reference_t<R>*, R>>;
+
+        F& m_f;
+        std::optional<stored_type> m_result{};
+    };
+
+    struct alignas(detail::k_machine_cache_line) slot
+    {
+        std::atomic<operation*> m_op{nullptr};
+    };
+
+public:
+    using value_type = T;
+
+    flat_combining() = default;
+
+    template<typename... Args>
+    explicit flat_combining(std::in_place_t, Args&&... args) : m_value(std::forward<Args>(args)...)
+    {
+    }
+
+    flat_combining(const flat_combining&) = delete;
+    flat_combining& operator=(const flat_combining&) = delete;
+    flat_combining(flat_combining&&) noexcept = delete;
+    flat_combining& operator=(flat_combining&&) noexcept = delete;
+
+    // runs f(T&) under the combiner and returns its result
+    template<typename F>
+    auto apply(F&& f) -> std::invoke_result_t<F&, T&>
+    {
+        using result_type = std::invoke_result_t<F&, T&>;
+        if (try_lock())
+        {
+            // uncontended, run in place; threads that published meanwhile combine once they get the lock
+            struct unlock_guard
+            {
+                ~unlock_guard()
+                {
+                    m_self->unlock(1);
+                }
+
+                flat_combining* m_self;
+            } guard{this};
+            return std::invoke(f, m_value);
+        }
+
+        bound_operation<F, result_type> op{f};
+        publish(op);
+        for (std::uint32_t spin = 0; not op.m_done.load(std::memory_order_acquire); ++spin)
+        {
+            if (try_lock())
+            {
+                unlock(combine());
+                continue;
+            }
+            backoff(spin);
+        }
+        if (op.m_error)
+        {
+            std::rethrow_exception(op.m_error);
+        }
+        if constexpr (std::is_reference_v<result_type>)
+        {
+            return static_cast<result_type>(**op.m_result);
+        }
+        else if constexpr (not std::is_void_v<result_type>)
+        {
+            return std::move(*op.m_result);
+        }
+    }
+
+    flat_combining_stats stats() const noexcept
+    {
+        return {m_combines.load(std::memory_order_relaxed), m_operations.load(std::memory_order_relaxed),
+                m_max_batch.load(std::memory_order_relaxed)};
+    }
+
+    // the wrapped structure, only while no other thread applies operations
+    T& unsafe_get() noexcept
+    {
+        return m_value;
+    }
+
+private:
+    static constexpr inline std::uint32_t k_combine_passes = 2;
+
+    bool try_lock() noexcept
+    {
+        return not m_lock.load(std::memory_order_relaxed) && not m_lock.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock(std::size_t batch) noexcept
+    {
+        // combiner only, plain read-modify-write of the counters is enough
+        if (batch != 0)
+        {
+            m_combines.store(m_combines.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            m_operations.store(m_operations.load(std::memory_order_relaxed) + batch, std::memory_order_relaxed);
+            if (batch > m_max_batch.load(std::memory_order_relaxed))
+            {
+                m_max_batch.store(batch, std::memory_order_relaxed);
+            }
+        }
+        m_lock.store(false, std::memory_order_release);
+    }
+
+    void publish(operation& op) noexcept
+    {
+        // threads start at different slots and probe forward when theirs is taken
+        static std::atomic<std::size_t> s_next_index{0};
+        static thread_local std::size_t s_index = s_next_index.fetch_add(1, std::memory_order_relaxed);
+        for (std::uint32_t spin = 0;; ++spin)
+        {
+            for (std::size_t i = 0; i < Slots; ++i)
+            {
+                auto& s = m_slots[(s_index + i) % Slots];
+                operation* expected{nullptr};
+                if (s.m_op.load(std::memory_order_relaxed) == nullptr &&
+                    s.m_op.compare_exchange_strong(expected, &op, std::memory_order_release,
+                                                   std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+            // every slot busy, a combiner pass frees them
+            if (try_lock())
+            {
+                unlock(combine());
+            }
+            backoff(spin);
+        }
+    }
+
+    // runs the published operations, returns how many
+    std::size_t combine() noexcept
+    {
+        std::size_t count{0};
+        for (std::uint32_t pass = 0; pass < k_combine_passes; ++pass)
+        {
+            std::size_t found{0};
+            for (auto& s : m_slots)
+            {
+                operation* op = s.m_op.load(std::memory_order_acquire);
+                if (op == nullptr)
+                {
+                    continue;
+                }
+                op->m_run(*op, m_value);
+                s.m_op.store(nullptr, std::memory_order_relaxed);
+                // the owner may return and destroy op as soon as it sees this
+                op->m_done.store(true, std::memory_order_release);
+                ++found;
+            }
+            if (found == 0)
+            {
+                break;
+            }
+            count += found;
+        }
+        return count;
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= 64)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<bool> m_lock{false};
+    std::atomic<std::size_t> m_combines{0};
+    std::atomic<std::size_t> m_operations{0};
+    std::atomic<std::size_t> m_max_batch{0};
+    alignas(detail::k_machine_cache_line) T m_value{};
+    slot m_slots[Slots]{};
+};
+
+} // namespace mlts
@@ -0,0 +1,128 @@
+#pragma once
+#include "detail/fork_task.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <exception>
+#include <functional>
+#include <thread>
+
+
+namespace mlts
+{
+
+// spawn + sync on a thread_pool: children are pushed to the calling worker's deque where idle
+// workers can steal them, the ones nobody stole are taken back and run inline at sync, so a
+// recursion never allocates and never blocks a worker on a child that has not started.
+// spawned callables are referenced, not copied, and must stay alive until sync
+template<typename Pool, size_t Size = 8>
+class fork_scope
+{
+public:
+    explicit fork_scope(Pool& pool) noexcept : m_pool(pool), m_deque(pool.local_fork_deque())
+    {
+    }
+
+    ~fork_scope()
+    {
+        join();
+    }
+
+    fork_scope(const fork_scope&) = delete;
+    fork_scope& operator=(const fork_scope&) = delete;
+    fork_scope(fork_scope&&) noexcept = delete;
+    fork_scope& operator=(fork_scope&&) noexcept = delete;
+
+    template<typename F>
+    void spawn(F& f)
+    {
+        if (m_size == Size) [[unlikely]]
+        {
+            std::invoke(f);
+            return;
+        }
+        auto& task = m_tasks[m_size++];
+        task.bind(f);
+        if (m_deque == nullptr)
+        {
+            // not on a worker of this pool, nothing to take back later; a pool that was shut down
+            // rejects the child, it runs here instead
+            if (not m_pool.push_func([ptr = &task]() { ptr->run(); })) [[unlikely]]
+            {
+                task.run();
+            }
+            return;
+        }
+        if (not m_deque->push(&task)) [[unlikely]]
+        {
+            task.run();
+            return;
+        }
+        ++m_pushed;
+        m_pool.notify_fork();
+    }
+
+    // waits for every spawned child and rethrows the first exception one of them threw
+    void sync()
+    {
+        join();
+        std::exception_ptr e{};
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            if (m_tasks[i].m_exception && not e)
+            {
+                e = m_tasks[i].m_exception;
+            }
+            m_tasks[i].m_exception = nullptr;
+            m_tasks[i].m_done.store(false, std::memory_order_relaxed);
+        }
+        m_size = 0;
+        if (e) [[unlikely]]
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    void join() noexcept
+    {
+        // our children are the newest entries of the deque, anything we can pop is ours
+        for (; m_pushed > 0; --m_pushed)
+        {
+            detail::fork_task* task{};
+            if (not m_deque->pop(task))
+            {
+                m_pushed = 0;
+                break;
+            }
+            task->run();
+        }
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            while (not m_tasks[i].is_done())
+            {
+                if (not m_pool.help_fork())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    Pool& m_pool;
+    typename Pool::fork_deque* m_deque;
+    std::array<detail::fork_task, Size> m_tasks{};
+    size_t m_size{0};
+    size_t m_pushed{0};
+};
+
+// runs a inline and b as a stealable child, returns once both finished
+template<typename Pool, typename FA, typename FB>
+void fork_join(Pool& pool, FA&& a, FB&& b)
+{
+    fork_scope<Pool, 1> scope(pool);
+    scope.spawn(b);
+    std::invoke(std::forward<FA>(a));
+    scope.sync();
+}
+
+} // namespace mlts
@@ -1,7 +1,11 @@
 #pragma once
+#include <cassert>
+#include <cstddef>
 #include <cstring>
-#include <functional>
 #include <exception>
+#include <functional>
+#include <new>
+#include <stdexcept>
 #include <type_traits>
 
 
@@ -130,12 +134,14 @@ class function<R(Args...), SSize>
             if constexpr (!is_small<F>())
             {
                 auto ptr = *reinterpret_cast<F**>(obj);
-                std::free(ptr);
+                ::operator delete(ptr);
             }
         }, +[](void* dst, const void* src) {
-            std::memcpy(data<F>(dst), data<F>(const_cast<void*>(src)), sizeof(F));
+            // trivially copyable, copied as raw bytes
+            std::memcpy(static_cast<void*>(data<F>(dst)), static_cast<const void*>(data<F>(const_cast<void*>(src))),
+                        sizeof(F));
         }, +[](void* dst, void* src) {
-            std::memcpy(data<F>(dst), data<F>(const_cast<void*>(src)), sizeof(F));
+            std::memcpy(static_cast<void*>(data<F>(dst)), static_cast<const void*>(data<F>(src)), sizeof(F));
         }, +[](void* obj, Args... args) noexcept(std::is_nothrow_invocable_v<F, Args...>) -> R {
             if constexpr (std::is_same_v<void, R>)
             {
@@ -211,6 +217,7 @@ public:
     }
 
     template<typename F>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, function>)
     constexpr function(F&& f) 
         noexcept(
             (!std::is_same_v<const function&, const std::decay_t<F>&> 
@@ -229,7 +236,7 @@ public:
         }
     }
 
-    constexpr function(const function& other) : m_vtable(other.m_vtable)
+    constexpr function(const function& other) : m_vtable(nullptr)
     {
         copy(other);
     }
@@ -267,6 +274,7 @@ public:
     }
 
     template<typename F>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, function>)
     constexpr function& operator=(F&& f) noexcept
     {
         this->~function();
@@ -341,7 +349,7 @@ public:
 
             if (!other.m_vtable->is_small)
             {
-                auto tmp = std::malloc(other.m_vtable->size);
+                auto tmp = ::operator new(other.m_vtable->size);
                 new (m_storage) void*(tmp);
             }
             other.m_vtable->copy(m_storage, other.m_storage);
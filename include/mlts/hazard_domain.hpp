@@ -0,0 +1,199 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/reclaim.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+
+namespace mlts
+{
+namespace detail
+{
+
+// live hazard holders per thread and domain
+constexpr inline std::size_t k_hazard_per_thread = 8;
+
+struct hazard_record : reclaim_record_base<hazard_record>
+{
+    // clears the hazards before the record goes to another thread
+    void reset() noexcept
+    {
+        for (auto& h : m_hazards)
+        {
+            h.store(nullptr, std::memory_order_relaxed);
+        }
+        m_used = 0;
+    }
+
+    alignas(k_machine_cache_line) std::array<std::atomic<const void*>, k_hazard_per_thread> m_hazards{};
+    std::uint32_t m_used{0};
+    // the owner's scan buffer, kept across scans so a pass normally allocates nothing
+    std::vector<const void*> m_scan{};
+    bool m_scanning{false};
+};
+
+struct hazard_state : reclaim_state_base<hazard_record>
+{
+    void reclaim(hazard_record& r) noexcept
+    {
+        // a deleter retiring into this domain may start a nested pass, the outer one still
+        // needs the scan buffer
+        if (r.m_scanning)
+        {
+            return;
+        }
+        r.m_scanning = true;
+        // pairs with the fence in protect, a hazard published before the unlink is seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (collect(r.m_scan))
+        {
+            auto& hazards = r.m_scan;
+            std::sort(hazards.begin(), hazards.end());
+            auto unprotected = [&hazards](const retired_ptr& p) {
+                return not std::binary_search(hazards.begin(), hazards.end(), static_cast<const void*>(p.m_ptr));
+            };
+            reclaim_if(r.m_retired, unprotected);
+            m_orphans.try_reclaim_if(unprotected);
+        }
+        r.m_scanning = false;
+    }
+
+private:
+    // false when the buffer could not hold every hazard, the pass then frees nothing and the
+    // next one retries
+    bool collect(std::vector<const void*>& hazards) noexcept
+    {
+        hazards.clear();
+        try
+        {
+            hazards.reserve(m_records.size() * k_hazard_per_thread);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+        bool complete{true};
+        m_records.for_each([&hazards, &complete](const hazard_record& rec) {
+            for (const auto& h : rec.m_hazards)
+            {
+                if (const void* p = h.load(std::memory_order_seq_cst))
+                {
+                    // records added since the reserve, never grow here
+                    if (hazards.size() == hazards.capacity())
+                    {
+                        complete = false;
+                        return;
+                    }
+                    hazards.push_back(p);
+                }
+            }
+        });
+        return complete;
+    }
+};
+
+class hazard_slot final : public reclaim_domain_slot<hazard_state, hazard_record>
+{
+public:
+    using reclaim_domain_slot::reclaim_domain_slot;
+
+    std::atomic<const void*>* acquire_hazard()
+    {
+        for (std::size_t i = 0; i < k_hazard_per_thread; ++i)
+        {
+            if ((m_record->m_used & (1u << i)) == 0)
+            {
+                m_record->m_used |= 1u << i;
+                return &m_record->m_hazards[i];
+            }
+        }
+        throw std::length_error("too many hazard holders on one thread");
+    }
+
+    void release_hazard(std::atomic<const void*>* hazard) noexcept
+    {
+        hazard->store(nullptr, std::memory_order_release);
+        m_record->m_used &= ~(1u << (hazard - m_record->m_hazards.data()));
+    }
+
+    void retire(void* p, void (*deleter)(void*))
+    {
+        append(p, deleter, 0);
+    }
+};
+
+} // namespace detail
+
+// hazard pointers: a reader publishes the pointer it is about to use, a retired object is freed
+// once no published hazard points at it. unlike epoch_domain a stalled reader only pins the
+// objects it protects. retire only appends to a thread local list, the scan runs from
+// quiescent_state() (thread_pool workers call it between tasks) or when a list grows past
+// detail::k_retire_limit
+class hazard_domain : public detail::reclaim_domain<detail::hazard_slot>
+{
+public:
+    // live holders per thread and domain
+    static constexpr inline std::size_t k_hazard_size = detail::k_hazard_per_thread;
+
+    // one published hazard, protects a single pointer at a time
+    class holder
+    {
+    public:
+        explicit holder(hazard_domain& domain) : m_slot(domain.local()), m_hazard(m_slot->acquire_hazard())
+        {
+        }
+
+        ~holder()
+        {
+            m_slot->release_hazard(m_hazard);
+        }
+
+        holder(const holder&) = delete;
+        holder& operator=(const holder&) = delete;
+        holder(holder&&) noexcept = delete;
+        holder& operator=(holder&&) noexcept = delete;
+
+        // loads src and keeps the result alive until reset, another protect or the holder's end
+        template<typename T>
+        T* protect(const std::atomic<T*>& src) noexcept
+        {
+            T* p = src.load(std::memory_order_relaxed);
+            while (1)
+            {
+                m_hazard->store(p, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                T* now = src.load(std::memory_order_acquire);
+                if (now == p)
+                {
+                    return p;
+                }
+                p = now;
+            }
+        }
+
+        void reset() noexcept
+        {
+            m_hazard->store(nullptr, std::memory_order_release);
+        }
+
+    private:
+        detail::hazard_slot* m_slot;
+        std::atomic<const void*>* m_hazard;
+    };
+
+    hazard_domain() = default;
+
+    static hazard_domain& global()
+    {
+        static hazard_domain s_domain{};
+        return s_domain;
+    }
+};
+
+} // namespace mlts
@@ -0,0 +1,181 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/intrusive_owner.hpp"
+#include <atomic>
+#include <cstddef>
+
+
+namespace mlts
+{
+
+// embedded link of an intrusive queue element, copying an element gives the copy a fresh hook
+struct intrusive_queue_hook
+{
+    intrusive_queue_hook() noexcept = default;
+
+    intrusive_queue_hook(const intrusive_queue_hook&) noexcept
+    {
+    }
+
+    intrusive_queue_hook& operator=(const intrusive_queue_hook&) noexcept
+    {
+        return *this;
+    }
+
+    std::atomic<intrusive_queue_hook*> m_next{nullptr};
+};
+
+// intrusive multiple producers, single consumer queue (Vyukov) linking elements through their hook:
+// push is one exchange and never allocates, the element must stay alive and unmodified until popped
+template<typename T, intrusive_queue_hook T::*Hook>
+class intrusive_mpsc_queue
+{
+public:
+    using value_type = T;
+
+    intrusive_mpsc_queue() noexcept
+    {
+        static_assert(std::atomic<intrusive_queue_hook*>::is_always_lock_free, "not support lock free");
+    }
+
+    intrusive_mpsc_queue(const intrusive_mpsc_queue&) = delete;
+    intrusive_mpsc_queue& operator=(const intrusive_mpsc_queue&) = delete;
+    intrusive_mpsc_queue(intrusive_mpsc_queue&&) noexcept = delete;
+    intrusive_mpsc_queue& operator=(intrusive_mpsc_queue&&) noexcept = delete;
+
+    void push(T& val) noexcept
+    {
+        push_hook(&(val.*Hook));
+    }
+
+    // consumer only, nullptr when empty or while the only pushed element is still being linked
+    T* pop() noexcept
+    {
+        intrusive_queue_hook* head = m_head;
+        intrusive_queue_hook* next = head->m_next.load(std::memory_order_acquire);
+        if (head == &m_stub)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            m_head = next;
+            head = next;
+            next = next->m_next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            m_head = next;
+            return detail::intrusive_owner<T, intrusive_queue_hook, Hook>(head);
+        }
+        if (head != m_tail.load(std::memory_order_acquire))
+        {
+            // a producer swapped the tail but has not linked it yet
+            return nullptr;
+        }
+        // head is the last element, the stub takes its place so it can be handed out
+        push_hook(&m_stub);
+        next = head->m_next.load(std::memory_order_acquire);
+        if (next)
+        {
+            m_head = next;
+            return detail::intrusive_owner<T, intrusive_queue_hook, Hook>(head);
+        }
+        return nullptr;
+    }
+
+    // consumer only
+    bool empty() const noexcept
+    {
+        return m_head->m_next.load(std::memory_order_acquire) == nullptr && m_head == &m_stub;
+    }
+
+private:
+    void push_hook(intrusive_queue_hook* hook) noexcept
+    {
+        hook->m_next.store(nullptr, std::memory_order_relaxed);
+        intrusive_queue_hook* prev = m_tail.exchange(hook, std::memory_order_acq_rel);
+        prev->m_next.store(hook, std::memory_order_release);
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<intrusive_queue_hook*> m_tail{&m_stub};
+    alignas(detail::k_machine_cache_line) intrusive_queue_hook* m_head{&m_stub};
+    intrusive_queue_hook m_stub{};
+};
+
+// intrusive single producer, single consumer queue without a stub: the consumer takes the last
+// element by clearing m_last, after which the producer restarts the chain through m_first.
+// push is one exchange, pop hands an element out as soon as it is linked
+template<typename T, intrusive_queue_hook T::*Hook>
+class intrusive_spsc_queue
+{
+public:
+    using value_type = T;
+
+    intrusive_spsc_queue() noexcept
+    {
+        static_assert(std::atomic<intrusive_queue_hook*>::is_always_lock_free, "not support lock free");
+    }
+
+    intrusive_spsc_queue(const intrusive_spsc_queue&) = delete;
+    intrusive_spsc_queue& operator=(const intrusive_spsc_queue&) = delete;
+    intrusive_spsc_queue(intrusive_spsc_queue&&) noexcept = delete;
+    intrusive_spsc_queue& operator=(intrusive_spsc_queue&&) noexcept = delete;
+
+    // producer only
+    void push(T& val) noexcept
+    {
+        intrusive_queue_hook* hook = &(val.*Hook);
+        hook->m_next.store(nullptr, std::memory_order_relaxed);
+        intrusive_queue_hook* prev = m_last.exchange(hook, std::memory_order_acq_rel);
+        if (prev)
+        {
+            // the consumer cannot take prev before this link is visible
+            prev->m_next.store(hook, std::memory_order_release);
+        }
+        else
+        {
+            m_first.store(hook, std::memory_order_release);
+        }
+    }
+
+    // consumer only, nullptr when empty or while the producer is linking behind the last element
+    T* pop() noexcept
+    {
+        intrusive_queue_hook* head = m_head;
+        if (head == nullptr)
+        {
+            head = m_first.exchange(nullptr, std::memory_order_acquire);
+            if (head == nullptr)
+            {
+                return nullptr;
+            }
+            m_head = head;
+        }
+        intrusive_queue_hook* next = head->m_next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            intrusive_queue_hook* last = head;
+            if (not m_last.compare_exchange_strong(last, nullptr, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+        }
+        m_head = next;
+        return detail::intrusive_owner<T, intrusive_queue_hook, Hook>(head);
+    }
+
+    // consumer only
+    bool empty() const noexcept
+    {
+        return m_head == nullptr && m_first.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    alignas(detail::k_machine_cache_line) std::atomic<intrusive_queue_hook*> m_last{nullptr};
+    alignas(detail::k_machine_cache_line) std::atomic<intrusive_queue_hook*> m_first{nullptr};
+    alignas(detail::k_machine_cache_line) intrusive_queue_hook* m_head{nullptr};
+};
+
+} // namespace mlts
@@ -2,11 +2,14 @@
 #include "define_type.hpp"
 #include "detail/config.hpp"
 #include "detail/queue_circular_buffer.hpp"
+#include "detail/queue_stats.hpp"
 #include <assert.h>
 #include <atomic>
 #include <bit>
-#include <mutex>
-#include <stdexcept>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
 
 
 namespace mlts
@@ -15,10 +18,18 @@ namespace mlts
 template<typename T>
 struct lock_free_circular_queue_node
 {
-    T m_value{};
-    bool m_has_value{false};
+    T* value() noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(m_storage));
+    }
+
+    // == position: free for the producer of that position, == position + 1: holds its value
+    std::atomic<std::size_t> m_sequence{0};
+    alignas(T) unsigned char m_storage[sizeof(T)];
 };
 
+// bounded multiple producers, multiple consumers queue (Vyukov), no locks: producers and consumers
+// claim a position with one CAS and hand the cell over through its sequence number
 template<typename T, std::uint32_t Capacity = 1024>
 struct lock_free_circular_queue
 {
@@ -27,67 +38,182 @@ public:
     using value_type = T;
     using difference_type = std::ptrdiff_t;
 
-    struct control
-    {
-        uint32_t m_head;
-        uint32_t m_tail;
-    };
+    static_assert(Capacity == DynamicSize32 || std::has_single_bit(Capacity), "capacity need power of two");
 
     lock_free_circular_queue() : m_buffer()
     {
-        static_assert(std::atomic<node*>::is_always_lock_free, "not support lock free");
-        static_assert(std::atomic<size_t>::is_always_lock_free, "not support lock free");
-        static_assert(std::atomic<control>::is_always_lock_free, "not support lock free");
-        // m_ctl.store(control{0, 1}, std::memory_order_relaxed);
+        init();
     }
 
-    ~lock_free_circular_queue() = default;
+    // Capacity == DynamicSize32 only, rounded up to a power of two
+    explicit lock_free_circular_queue(std::uint32_t capacity)
+        requires(Capacity == DynamicSize32)
+        : m_buffer(capacity)
+    {
+        init();
+    }
+
+    ~lock_free_circular_queue()
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        for (auto head = m_head.load(std::memory_order_relaxed); head != tail; ++head)
+        {
+            std::destroy_at(m_buffer[head & m_buffer.mask()].value());
+        }
+    }
 
     lock_free_circular_queue(const lock_free_circular_queue&) = delete;
     lock_free_circular_queue& operator=(const lock_free_circular_queue&) = delete;
     lock_free_circular_queue(lock_free_circular_queue&& other) noexcept = delete;
     lock_free_circular_queue& operator=(lock_free_circular_queue&& other) noexcept = delete;
 
-
-    template<typename TValue>
-    void push(TValue val)
+    // returns false when full
+    template<typename... Args>
+    bool try_emplace(Args&&... args)
     {
-        std::lock_guard lk(m_mu);
-        std::uint32_t tail, head, new_tail;
-        while(m_size.load(std::memory_order_acquire) == Capacity)
+        std::size_t pos = m_tail.load(std::memory_order_relaxed);
+        node* cell{};
+        while (1)
         {
+            cell = &m_buffer[pos & m_buffer.mask()];
+            auto seq = cell->m_sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<difference_type>(seq) - static_cast<difference_type>(pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
         }
+        std::construct_at(cell->value(), std::forward<Args>(args)...);
+        cell->m_sequence.store(pos + 1, std::memory_order_release);
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(detail::queue_size_approx(pos + 1, m_head.load(std::memory_order_relaxed)));
+        }
+        return true;
+    }
 
-        m_buffer[tail] = std::forward<TValue>(val);
+    template<typename TValue>
+    bool try_push(TValue&& val)
+    {
+        return try_emplace(std::forward<TValue>(val));
     }
 
-    bool pop(value_type& val)
+    // spins while full
+    template<typename TValue>
+    void push(TValue&& val)
     {
+        for (std::uint32_t spin = 0; not try_emplace(std::forward<TValue>(val)); ++spin)
+        {
+            backoff(spin);
+        }
+    }
 
-        auto tail = m_tail.load();
-        auto head = m_head.load();
-        if(tail == head)
+    // returns false when empty
+    bool try_pop(value_type& val)
+    {
+        std::size_t pos = m_head.load(std::memory_order_relaxed);
+        node* cell{};
+        while (1)
         {
-            return false;
+            cell = &m_buffer[pos & m_buffer.mask()];
+            auto seq = cell->m_sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<difference_type>(seq) - static_cast<difference_type>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
         }
-        auto new_head = (head + 1) & m_buffer.mask();
-        val = std::move(m_buffer[new_head]);
-        m_head= new_head;
+        // the cell goes back to producers even if the move throws, the value is dropped then
+        struct release_guard
+        {
+            ~release_guard()
+            {
+                std::destroy_at(m_cell->value());
+                m_cell->m_sequence.store(m_sequence, std::memory_order_release);
+            }
+
+            node* m_cell;
+            std::size_t m_sequence;
+        } guard{cell, pos + capacity()};
+        val = std::move(*cell->value());
         return true;
     }
 
-    constexpr auto capacity() const
+    // spins while empty
+    void pop(value_type& val)
+    {
+        for (std::uint32_t spin = 0; not try_pop(val); ++spin)
+        {
+            backoff(spin);
+        }
+    }
+
+    constexpr std::size_t capacity() const
     {
         return m_buffer.size();
     }
 
+    // any thread, counts claimed positions so values still being written or read are included
+    std::size_t size_approx() const noexcept
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_tail.load(std::memory_order_relaxed), head);
+    }
+
+    bool empty() const noexcept
+    {
+        return size_approx() == 0;
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_tail.load(std::memory_order_relaxed), m_head.load(std::memory_order_relaxed), m_high_water.value()};
+    }
+
     // private:
-    std::mutex m_mu;
-    detail::queue_circular_buffer<T, Capacity> m_buffer{};
-    // std::atomic<control> m_ctl{};
-    std::atomic<std::uint32_t> m_head{};
-    std::atomic<std::uint32_t> m_tail{};
-    std::atomic<std::uint32_t> m_size{};
+    void init() noexcept
+    {
+        static_assert(std::atomic<std::size_t>::is_always_lock_free, "not support lock free");
+        for (std::size_t i = 0; i < capacity(); ++i)
+        {
+            m_buffer[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= 64)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    detail::queue_circular_buffer<node, Capacity> m_buffer{};
+    alignas(detail::k_machine_cache_line) std::atomic<std::size_t> m_head{0};
+    alignas(detail::k_machine_cache_line) std::atomic<std::size_t> m_tail{0};
+    detail::queue_high_water m_high_water{};
 };
 
 
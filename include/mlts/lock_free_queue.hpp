@@ -1,8 +1,17 @@
 #pragma once
 #include "detail/config.hpp"
+#include "detail/event_count.hpp"
+#include "detail/queue_stats.hpp"
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <thread>
 #include <type_traits>
+#include <utility>
 
 
 namespace mlts
@@ -11,12 +20,32 @@ namespace mlts
 template<typename T>
 struct lock_free_queue_node
 {
-    T m_value{};
+    // the stub, holds no value
+    lock_free_queue_node() noexcept
+    {
+    }
+
+    template<typename... Args>
+    explicit lock_free_queue_node(std::in_place_t, Args&&... args) : m_value(std::forward<Args>(args)...)
+    {
+    }
+
+    // the queue ends the lifetime of the value once it is consumed, the node becomes the stub
+    ~lock_free_queue_node()
+    {
+    }
+
+    union
+    {
+        T m_value;
+    };
     std::atomic<lock_free_queue_node*> m_next{};
 };
 
-// apply for single consumer, multiple producers
-template<typename T, typename Alloc = std::allocator<lock_free_queue_node<std::remove_cvref_t<T>>>>
+// apply for single consumer, multiple producers.
+// Blocking adds wait_pop and wait_pop_for, every publish then pays a fence and a load to look for
+// a parked consumer; the plain queue keeps no event count and publishes with the tail exchange only
+template<typename T, typename Alloc = std::allocator<lock_free_queue_node<std::remove_cvref_t<T>>>, bool Blocking = false>
 class lock_free_queue
 {
 
@@ -36,9 +65,16 @@ public:
 
     ~lock_free_queue()
     {
-        while (node* n = m_head.load(std::memory_order_relaxed))
+        // every node after the stub holds a value
+        node* n = m_head.load(std::memory_order_relaxed);
+        node* next = n->m_next.load(std::memory_order_relaxed);
+        std::destroy_at(n);
+        m_alloc.deallocate(n, 1);
+        while (next)
         {
-            m_head.store(n->m_next, std::memory_order_relaxed);
+            n = next;
+            next = n->m_next.load(std::memory_order_relaxed);
+            std::destroy_at(std::addressof(n->m_value));
             std::destroy_at(n);
             m_alloc.deallocate(n, 1);
         }
@@ -49,16 +85,20 @@ public:
     lock_free_queue(lock_free_queue&&) noexcept = delete;
     lock_free_queue& operator=(lock_free_queue&&) noexcept = delete;
 
+    class batch_producer;
+
+    // constructs the value directly in its node
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        node* n = make_node(std::forward<Args>(args)...);
+        link(n, n, 1);
+    }
+
     template<typename TValue>
     void push(TValue&& val)
     {
-        node* n = m_alloc.allocate(1);
-        std::construct_at<node>(n, T{std::forward<TValue>(val)}, nullptr);
-        node* o = m_tail.load(std::memory_order_relaxed);
-        while (not m_tail.compare_exchange_weak(o, n, std::memory_order_release, std::memory_order_relaxed))
-        {
-        }
-        o->m_next.store(n, std::memory_order_release);
+        emplace(std::forward<TValue>(val));
     }
 
     bool pop(value_type& val)
@@ -70,16 +110,364 @@ public:
             return false;
         }
         val = std::move(n->m_value);
-        m_head.store(n, std::memory_order_relaxed);
-        std::destroy_at(o);
-        m_alloc.deallocate(o, 1);
+        std::destroy_at(std::addressof(n->m_value));
+        release(o, n, 1);
         return true;
     }
 
+    // move constructs the front value, no default constructed value_type needed
+    std::optional<value_type> pop()
+    {
+        // a single returned object keeps NRVO, the value is moved exactly once
+        std::optional<value_type> ret{};
+        node* const o = m_head.load(std::memory_order_relaxed);
+        node* const n = o->m_next.load(std::memory_order_acquire);
+        if (n != nullptr) [[likely]]
+        {
+            ret.emplace(std::move(n->m_value));
+            std::destroy_at(std::addressof(n->m_value));
+            release(o, n, 1);
+        }
+        return ret;
+    }
+
+    // calls f with the front value where it lives, if f throws the value stays at the front
+    template<typename F>
+        requires std::invocable<F&, value_type&>
+    bool pop(F&& f)
+    {
+        node* const o = m_head.load(std::memory_order_relaxed);
+        node* const n = o->m_next.load(std::memory_order_acquire);
+        if (n == nullptr) [[unlikely]]
+        {
+            return false;
+        }
+        std::invoke(f, n->m_value);
+        std::destroy_at(std::addressof(n->m_value));
+        release(o, n, 1);
+        return true;
+    }
+
+    // spins briefly, then parks until a value arrives
+    void wait_pop(value_type& val)
+        requires Blocking
+    {
+        if (spin_pop(val))
+        {
+            return;
+        }
+        while (1)
+        {
+            auto key = m_event.prepare_wait();
+            if (pop(val))
+            {
+                m_event.cancel_wait();
+                return;
+            }
+            m_event.wait(key);
+            if (pop(val))
+            {
+                return;
+            }
+        }
+    }
+
+    // false when nothing arrived within timeout
+    template<typename Rep, typename Period>
+        requires Blocking
+    bool wait_pop_for(value_type& val, const std::chrono::duration<Rep, Period>& timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (spin_pop(val))
+        {
+            return true;
+        }
+        while (1)
+        {
+            auto key = m_event.prepare_wait();
+            if (pop(val))
+            {
+                m_event.cancel_wait();
+                return true;
+            }
+            if (not m_event.wait_until(key, deadline))
+            {
+                return pop(val);
+            }
+            if (pop(val))
+            {
+                return true;
+            }
+        }
+    }
+
+    // any thread, a snapshot that may be stale by the time it returns
+    std::size_t size_approx() const noexcept
+    {
+        auto dequeued = m_dequeued.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_enqueued.load(std::memory_order_relaxed), dequeued);
+    }
+
+    // any thread, compares the ends without touching a node; a push still linking counts as a value
+    bool empty() const noexcept
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_enqueued.load(std::memory_order_relaxed), m_dequeued.load(std::memory_order_relaxed),
+                m_high_water.value()};
+    }
+
+    // moves up to max values to out, returns how many were moved
+    template<typename OutputIt>
+    std::size_t pop_bulk(OutputIt out, std::size_t max)
+    {
+        auto f = [&out](value_type& val) {
+            *out = std::move(val);
+            ++out;
+        };
+        return consume(max, f);
+    }
+
+    // calls f with every value published so far, in order; the chain is walked once, m_head is
+    // stored once and the nodes go back to the allocator as one chain. every value is destroyed
+    // as soon as f returns from it, if f throws, the value it threw on stays at the front
+    template<typename F>
+    std::size_t consume_all(F&& f)
+    {
+        return consume(static_cast<std::size_t>(-1), f);
+    }
+
 private:
+    template<typename... Args>
+    node* make_node(Args&&... args)
+    {
+        node* n = m_alloc.allocate(1);
+        try
+        {
+            std::construct_at<node>(n, std::in_place, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            m_alloc.deallocate(n, 1);
+            throw;
+        }
+        return n;
+    }
+
+    // publishes the chain first..last, already linked by the caller, with one tail exchange
+    void link(node* first, node* last, std::size_t count) noexcept
+    {
+        node* o = m_tail.exchange(last, std::memory_order_acq_rel);
+        o->m_next.store(first, std::memory_order_release);
+        // one relaxed add per chain on the line the exchange above already owns, batch_producer
+        // pays it once per batch
+        auto enqueued = m_enqueued.fetch_add(count, std::memory_order_relaxed) + count;
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(detail::queue_size_approx(enqueued, m_dequeued.load(std::memory_order_relaxed)));
+        }
+        // one wakeup per chain, the consumer drains the whole chain before it parks again
+        m_event.notify_one();
+    }
+
+    bool spin_pop(value_type& val)
+    {
+        for (std::uint32_t spin = 0; spin < k_wait_spin; ++spin)
+        {
+            if (pop(val))
+            {
+                return true;
+            }
+            if (spin >= k_wait_spin / 2)
+            {
+                std::this_thread::yield();
+            }
+        }
+        return false;
+    }
+
+    template<typename F>
+    std::size_t consume(std::size_t max, F& f)
+    {
+        node* const first = m_head.load(std::memory_order_relaxed);
+        node* last = first;
+        std::size_t count{0};
+        try
+        {
+            for (; count < max; ++count)
+            {
+                node* const n = last->m_next.load(std::memory_order_acquire);
+                if (n == nullptr)
+                {
+                    break;
+                }
+                std::invoke(f, n->m_value);
+                std::destroy_at(std::addressof(n->m_value));
+                last = n;
+            }
+        }
+        catch (...)
+        {
+            release(first, last, count);
+            throw;
+        }
+        release(first, last, count);
+        return count;
+    }
+
+    // last becomes the new stub, the count nodes before it go back to the allocator,
+    // in one call when the allocator takes chains
+    void release(node* first, node* last, std::size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        m_head.store(last, std::memory_order_relaxed);
+        auto next = [](node* n) noexcept {
+            node* const ret = n->m_next.load(std::memory_order_relaxed);
+            std::destroy_at(n);
+            return ret;
+        };
+        if constexpr (requires { m_alloc.deallocate_chain(first, count, next); })
+        {
+            m_alloc.deallocate_chain(first, count, next);
+        }
+        else
+        {
+            while (first != last)
+            {
+                node* const n = next(first);
+                m_alloc.deallocate(first, 1);
+                first = n;
+            }
+        }
+        // single consumer, no read-modify-write needed
+        m_dequeued.store(m_dequeued.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+
+    static constexpr inline std::uint32_t k_wait_spin = 128;
+
+    // the consumer parks on its own line, away from the producers' tail
+    struct alignas(detail::k_machine_cache_line) event_type : detail::event_count
+    {
+    };
+
     alignas(detail::k_machine_cache_line) std::atomic<node*> m_head{nullptr};
+    std::atomic<std::size_t> m_dequeued{0};
     alignas(detail::k_machine_cache_line) std::atomic<node*> m_tail{nullptr};
+    std::atomic<std::size_t> m_enqueued{0};
+    detail::queue_high_water m_high_water{};
     Alloc m_alloc{};
+    [[no_unique_address]] std::conditional_t<Blocking, event_type, detail::null_event_count> m_event{};
+};
+
+// a producer side staging chain owned by one thread: values are linked locally and published to
+// the queue in one tail exchange once batch_size are staged, on flush(), or when the oldest staged
+// value waited longer than max_delay. the shared tail and the consumer wakeup are touched once per
+// batch instead of once per value, staged values are invisible to the consumer until published.
+// max_delay is checked on emplace and flush_due only, there is no timer thread
+template<typename T, typename Alloc, bool Blocking>
+class lock_free_queue<T, Alloc, Blocking>::batch_producer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit batch_producer(lock_free_queue& queue, std::size_t batch_size = k_default_batch_size,
+                            clock::duration max_delay = clock::duration::max())
+        : m_queue(queue), m_batch_size(batch_size == 0 ? 1 : batch_size), m_max_delay(max_delay)
+    {
+    }
+
+    ~batch_producer()
+    {
+        flush();
+    }
+
+    batch_producer(const batch_producer&) = delete;
+    batch_producer& operator=(const batch_producer&) = delete;
+    batch_producer(batch_producer&&) noexcept = delete;
+    batch_producer& operator=(batch_producer&&) noexcept = delete;
+
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        node* n = m_queue.make_node(std::forward<Args>(args)...);
+        if (m_last == nullptr)
+        {
+            m_first = n;
+            if (m_max_delay != clock::duration::max())
+            {
+                m_deadline = clock::now() + m_max_delay;
+            }
+        }
+        else
+        {
+            m_last->m_next.store(n, std::memory_order_relaxed);
+        }
+        m_last = n;
+        if (++m_count >= m_batch_size || (m_max_delay != clock::duration::max() && clock::now() >= m_deadline))
+        {
+            flush();
+        }
+    }
+
+    template<typename TValue>
+    void push(TValue&& val)
+    {
+        emplace(std::forward<TValue>(val));
+    }
+
+    // publishes everything staged
+    void flush() noexcept
+    {
+        if (m_last == nullptr)
+        {
+            return;
+        }
+        m_queue.link(m_first, m_last, m_count);
+        m_first = nullptr;
+        m_last = nullptr;
+        m_count = 0;
+    }
+
+    // publishes when the oldest staged value is past max_delay, for producers going idle
+    bool flush_due()
+    {
+        if (m_last == nullptr || m_max_delay == clock::duration::max() || clock::now() < m_deadline)
+        {
+            return false;
+        }
+        flush();
+        return true;
+    }
+
+    std::size_t staged() const noexcept
+    {
+        return m_count;
+    }
+
+    std::size_t batch_size() const noexcept
+    {
+        return m_batch_size;
+    }
+
+private:
+    static constexpr inline std::size_t k_default_batch_size = 32;
+
+    lock_free_queue& m_queue;
+    node* m_first{nullptr};
+    node* m_last{nullptr};
+    std::size_t m_count{0};
+    const std::size_t m_batch_size;
+    const clock::duration m_max_delay;
+    clock::time_point m_deadline{};
 };
 
+template<typename T, typename Alloc = std::allocator<lock_free_queue_node<std::remove_cvref_t<T>>>>
+using blocking_lock_free_queue = lock_free_queue<T, Alloc, true>;
+
 } // namespace mlts
\ No newline at end of file
@@ -0,0 +1,431 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/queue_stats.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+
+
+namespace mlts
+{
+
+template<typename T>
+struct lock_free_segment_queue_cell
+{
+    enum class state : std::uint8_t
+    {
+        empty,
+        ready,
+        // the producer of the ticket failed to construct its value, consumers skip the cell
+        abandoned,
+    };
+
+    T* value() noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(m_storage));
+    }
+
+    std::atomic<state> m_state{state::empty};
+    alignas(T) unsigned char m_storage[sizeof(T)];
+};
+
+template<typename T, std::size_t SegmentSize>
+struct lock_free_segment_queue_segment
+{
+    static constexpr inline std::size_t k_retired_id = std::numeric_limits<std::size_t>::max();
+
+    // index of the segment in the ticket space, set before the segment is linked and
+    // k_retired_id while it waits in the pool; every link gets a new id, ids never repeat
+    std::atomic<std::size_t> m_id{k_retired_id};
+    // m_id once the link is published, validates the lookup hints
+    std::atomic<std::size_t> m_linked_id{k_retired_id};
+    std::atomic<std::size_t> m_popped{0};
+    // the successor, or an end mark carrying m_id while this is the last segment
+    std::atomic<std::uintptr_t> m_next{0};
+    lock_free_segment_queue_segment* m_pool_next{nullptr};
+    std::array<lock_free_segment_queue_cell<T>, SegmentSize> m_cells{};
+};
+
+// unbounded multiple producers, multiple consumers queue made of fixed size segments:
+// producers and consumers take a global ticket with one atomic operation and use the cell of
+// that ticket. the segment list is extended with a compare-and-swap on the end mark of the last
+// segment, the end mark carries the segment id so a recycled segment never takes a stale link.
+// fully consumed segments are unlinked from the front by whichever consumer completes them and
+// go to a pool for reuse, segment memory is only released by the destructor so a stale segment
+// pointer is always safe to read.
+// a producer whose value constructor throws marks its cell abandoned and consumers skip it
+template<typename T, std::size_t SegmentSize = 256>
+class lock_free_segment_queue
+{
+    static_assert(std::has_single_bit(SegmentSize), "segment size need power of two");
+
+public:
+    using value_type = T;
+    using segment = lock_free_segment_queue_segment<T, SegmentSize>;
+    using cell = lock_free_segment_queue_cell<T>;
+
+    lock_free_segment_queue()
+    {
+        static_assert(std::atomic<std::size_t>::is_always_lock_free, "not support lock free");
+        static_assert(std::atomic<std::uintptr_t>::is_always_lock_free, "not support lock free");
+        segment* s = new segment{};
+        s->m_id.store(0, std::memory_order_relaxed);
+        s->m_linked_id.store(0, std::memory_order_relaxed);
+        s->m_next.store(end_mark(0), std::memory_order_relaxed);
+        m_head.store(s, std::memory_order_relaxed);
+        m_recent[0].store(s, std::memory_order_relaxed);
+    }
+
+    ~lock_free_segment_queue()
+    {
+        auto tail = m_enqueue.load(std::memory_order_relaxed);
+        for (auto head = m_dequeue.load(std::memory_order_relaxed); head != tail; ++head)
+        {
+            auto& c = find_segment(head / SegmentSize, false)->m_cells[head & k_mask];
+            if (c.m_state.load(std::memory_order_relaxed) == cell::state::ready)
+            {
+                std::destroy_at(c.value());
+            }
+        }
+        for (segment* s = m_head.load(std::memory_order_relaxed); s;)
+        {
+            auto next = s->m_next.load(std::memory_order_relaxed);
+            delete s;
+            s = is_end(next) ? nullptr : to_segment(next);
+        }
+        for (segment* s = m_pool.load(std::memory_order_relaxed); s;)
+        {
+            segment* next = s->m_pool_next;
+            delete s;
+            s = next;
+        }
+    }
+
+    lock_free_segment_queue(const lock_free_segment_queue&) = delete;
+    lock_free_segment_queue& operator=(const lock_free_segment_queue&) = delete;
+    lock_free_segment_queue(lock_free_segment_queue&&) noexcept = delete;
+    lock_free_segment_queue& operator=(lock_free_segment_queue&&) noexcept = delete;
+
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        auto ticket = m_enqueue.fetch_add(1, std::memory_order_relaxed);
+        auto& c = producer_cell(ticket);
+        try
+        {
+            std::construct_at(c.value(), std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            c.m_state.store(cell::state::abandoned, std::memory_order_release);
+            throw;
+        }
+        c.m_state.store(cell::state::ready, std::memory_order_release);
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(detail::queue_size_approx(ticket + 1, m_dequeue.load(std::memory_order_relaxed)));
+        }
+    }
+
+    template<typename TValue>
+    void push(TValue&& val)
+    {
+        emplace(std::forward<TValue>(val));
+    }
+
+    // returns false when empty
+    bool pop(value_type& val)
+    {
+        while (1)
+        {
+            auto ticket = m_dequeue.load(std::memory_order_relaxed);
+            do
+            {
+                if (ticket >= m_enqueue.load(std::memory_order_relaxed))
+                {
+                    return false;
+                }
+            } while (not m_dequeue.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed));
+
+            segment* s = find_segment(ticket / SegmentSize, false);
+            auto& c = s->m_cells[ticket & k_mask];
+            // the producer of this ticket already took it and is about to publish
+            auto state = c.m_state.load(std::memory_order_acquire);
+            for (std::uint32_t spin = 0; state == cell::state::empty; state = c.m_state.load(std::memory_order_acquire))
+            {
+                backoff(++spin);
+            }
+            if (state == cell::state::ready) [[likely]]
+            {
+                val = std::move(*c.value());
+                std::destroy_at(c.value());
+            }
+            c.m_state.store(cell::state::empty, std::memory_order_relaxed);
+            // seq_cst pairs with the retire flag, a completed segment is never left unretired
+            if (s->m_popped.fetch_add(1, std::memory_order_seq_cst) + 1 == SegmentSize)
+            {
+                retire();
+            }
+            if (state == cell::state::ready) [[likely]]
+            {
+                return true;
+            }
+        }
+    }
+
+    // any thread, counts taken tickets so values still being written or read are included,
+    // so are abandoned cells until a consumer skips them
+    std::size_t size_approx() const noexcept
+    {
+        auto dequeued = m_dequeue.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_enqueue.load(std::memory_order_relaxed), dequeued);
+    }
+
+    bool empty() const noexcept
+    {
+        return size_approx() == 0;
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_enqueue.load(std::memory_order_relaxed), m_dequeue.load(std::memory_order_relaxed),
+                m_high_water.value()};
+    }
+
+    // segments owned by the queue, live and pooled
+    std::size_t segment_count() const noexcept
+    {
+        return m_segment_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr inline std::size_t k_mask = SegmentSize - 1;
+    static constexpr inline std::size_t k_recent_mask = 63;
+
+    // segments are at least pointer aligned, an odd word is an end mark
+    static constexpr std::uintptr_t end_mark(std::size_t id) noexcept
+    {
+        return (static_cast<std::uintptr_t>(id) << 1) | 1;
+    }
+
+    static constexpr bool is_end(std::uintptr_t next) noexcept
+    {
+        return next & 1;
+    }
+
+    static segment* to_segment(std::uintptr_t next) noexcept
+    {
+        return reinterpret_cast<segment*>(next);
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= 64)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // the caller holds a ticket of segment id, so the segment is not retired under it
+    segment* find_segment(std::size_t id, bool extend)
+    {
+        segment* s = m_recent[id & k_recent_mask].load(std::memory_order_acquire);
+        if (s && s->m_linked_id.load(std::memory_order_acquire) == id) [[likely]]
+        {
+            return s;
+        }
+        return find_segment_slow(id, extend);
+    }
+
+    // consumers wait for the cell of every ticket, a producer that cannot allocate the segment
+    // of its ticket retries until the segment is linked by it or by another producer
+    cell& producer_cell(std::size_t ticket)
+    {
+        while (1)
+        {
+            try
+            {
+                return find_segment(ticket / SegmentSize, true)->m_cells[ticket & k_mask];
+            }
+            catch (const std::bad_alloc&)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // walks the list from a validated start, every step checks that the segment it came from kept
+    // its id while the link was read; a segment recycled under the walk restarts it
+    MLTS_COLD segment* find_segment_slow(std::size_t id, bool extend)
+    {
+        for (std::uint32_t spin = 0;; backoff(++spin))
+        {
+            std::size_t sid{};
+            segment* s = walk_start(id, sid);
+            while (s && sid < id)
+            {
+                auto next = s->m_next.load(std::memory_order_acquire);
+                if (is_end(next))
+                {
+                    // a stale end mark, or the producer of id has not linked the segment yet
+                    if (next != end_mark(sid) || not extend)
+                    {
+                        s = nullptr;
+                        break;
+                    }
+                    next = append(s, sid);
+                    if (is_end(next))
+                    {
+                        s = nullptr;
+                        break;
+                    }
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s->m_id.load(std::memory_order_relaxed) != sid)
+                {
+                    s = nullptr;
+                    break;
+                }
+                s = to_segment(next);
+                if (s->m_id.load(std::memory_order_acquire) != ++sid)
+                {
+                    s = nullptr;
+                    break;
+                }
+            }
+            if (s && sid == id)
+            {
+                if (s->m_linked_id.load(std::memory_order_acquire) == id)
+                {
+                    m_recent[id & k_recent_mask].store(s, std::memory_order_release);
+                }
+                return s;
+            }
+        }
+    }
+
+    // a segment with an id not past id, or nullptr when the hints changed under the read
+    segment* walk_start(std::size_t id, std::size_t& sid) noexcept
+    {
+        if (id > 0)
+        {
+            segment* s = m_recent[(id - 1) & k_recent_mask].load(std::memory_order_acquire);
+            if (s && s->m_linked_id.load(std::memory_order_acquire) == id - 1 &&
+                s->m_id.load(std::memory_order_acquire) == id - 1)
+            {
+                sid = id - 1;
+                return s;
+            }
+        }
+        // the head is only ever set to linked segments, it still being the head validates its id
+        segment* s = m_head.load(std::memory_order_acquire);
+        sid = s->m_id.load(std::memory_order_acquire);
+        if (sid > id || m_head.load(std::memory_order_acquire) != s)
+        {
+            return nullptr;
+        }
+        return s;
+    }
+
+    // links a segment after s, returns the successor of s, ours or the one that won the race,
+    // or an end mark when s was recycled meanwhile
+    std::uintptr_t append(segment* s, std::size_t sid)
+    {
+        segment* n = take_segment();
+        n->m_id.store(sid + 1, std::memory_order_relaxed);
+        n->m_next.store(end_mark(sid + 1), std::memory_order_relaxed);
+        auto expected = end_mark(sid);
+        if (s->m_next.compare_exchange_strong(expected, reinterpret_cast<std::uintptr_t>(n),
+                                              std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            n->m_linked_id.store(sid + 1, std::memory_order_release);
+            m_recent[(sid + 1) & k_recent_mask].store(n, std::memory_order_release);
+            return reinterpret_cast<std::uintptr_t>(n);
+        }
+        n->m_id.store(segment::k_retired_id, std::memory_order_relaxed);
+        give_segments(n, n);
+        return expected;
+    }
+
+    // the pool is taken whole with one exchange, so a pop never races another pop
+    segment* take_segment()
+    {
+        segment* s = m_pool.exchange(nullptr, std::memory_order_acquire);
+        if (s == nullptr)
+        {
+            s = new segment{};
+            m_segment_count.fetch_add(1, std::memory_order_relaxed);
+            return s;
+        }
+        if (segment* rest = s->m_pool_next)
+        {
+            segment* last = rest;
+            while (last->m_pool_next)
+            {
+                last = last->m_pool_next;
+            }
+            give_segments(rest, last);
+        }
+        s->m_pool_next = nullptr;
+        s->m_popped.store(0, std::memory_order_relaxed);
+        return s;
+    }
+
+    void give_segments(segment* first, segment* last) noexcept
+    {
+        segment* top = m_pool.load(std::memory_order_relaxed);
+        do
+        {
+            last->m_pool_next = top;
+        } while (not m_pool.compare_exchange_weak(top, first, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // segments can complete out of order, only the fully consumed prefix goes back to the pool.
+    // one thread trims at a time, a thread finding the flag taken leaves the work to its holder,
+    // which looks at the head again after dropping the flag
+    MLTS_COLD void retire()
+    {
+        while (not m_retiring.exchange(true, std::memory_order_seq_cst))
+        {
+            segment* h = m_head.load(std::memory_order_relaxed);
+            while (retirable(h))
+            {
+                segment* next = to_segment(h->m_next.load(std::memory_order_acquire));
+                m_head.store(next, std::memory_order_release);
+                h->m_linked_id.store(segment::k_retired_id, std::memory_order_relaxed);
+                h->m_id.store(segment::k_retired_id, std::memory_order_release);
+                give_segments(h, h);
+                h = next;
+            }
+            m_retiring.store(false, std::memory_order_seq_cst);
+            if (not retirable(h))
+            {
+                return;
+            }
+        }
+    }
+
+    // the last segment stays until a successor is linked
+    static bool retirable(segment* s) noexcept
+    {
+        return s->m_popped.load(std::memory_order_seq_cst) == SegmentSize &&
+               not is_end(s->m_next.load(std::memory_order_acquire));
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<std::size_t> m_enqueue{0};
+    detail::queue_high_water m_high_water{};
+    alignas(detail::k_machine_cache_line) std::atomic<std::size_t> m_dequeue{0};
+    // recently linked segments by id, a hint validated against the linked id
+    alignas(detail::k_machine_cache_line) std::array<std::atomic<segment*>, k_recent_mask + 1> m_recent{};
+    alignas(detail::k_machine_cache_line) std::atomic<segment*> m_head{nullptr};
+    std::atomic<bool> m_retiring{false};
+    std::atomic<segment*> m_pool{nullptr};
+    std::atomic<std::size_t> m_segment_count{1};
+};
+
+} // namespace mlts
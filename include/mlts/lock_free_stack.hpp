@@ -0,0 +1,198 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/intrusive_owner.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+
+namespace mlts
+{
+
+// embedded link of a lock_free_stack element, copying an element gives the copy a fresh hook
+struct lock_free_stack_hook
+{
+    lock_free_stack_hook() noexcept = default;
+
+    lock_free_stack_hook(const lock_free_stack_hook&) noexcept
+    {
+    }
+
+    lock_free_stack_hook& operator=(const lock_free_stack_hook&) noexcept
+    {
+        return *this;
+    }
+
+    std::atomic<lock_free_stack_hook*> m_next{nullptr};
+};
+
+// intrusive Treiber stack, the top pointer carries a tag that changes on every update so a pop
+// racing with pop + push of the same element fails its CAS (ABA). the tag lives in the unused
+// upper 16 bits of a 64 bit address, or next to the pointer on 32 bit targets.
+// an element whose address needs those bits (5 level paging) switches the stack for good to an
+// untagged top marked in bit 0, pushes stay lock free and pops take a spinlock instead.
+// a popping thread may still read the hook of an element another thread just popped, elements
+// must stay readable while the stack is in use (free lists, pools); pop_all has no such race
+template<typename T, lock_free_stack_hook T::*Hook>
+class lock_free_stack
+{
+public:
+    using value_type = T;
+
+    lock_free_stack() noexcept
+    {
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "not support lock free");
+    }
+
+    lock_free_stack(const lock_free_stack&) = delete;
+    lock_free_stack& operator=(const lock_free_stack&) = delete;
+    lock_free_stack(lock_free_stack&&) noexcept = delete;
+    lock_free_stack& operator=(lock_free_stack&&) noexcept = delete;
+
+    void push(T& val) noexcept
+    {
+        push_chain(val, val);
+    }
+
+    // first .. last already linked with link(), pushed with a single CAS
+    void push_chain(T& first, T& last) noexcept
+    {
+        lock_free_stack_hook* head = &(first.*Hook);
+        lock_free_stack_hook* tail = &(last.*Hook);
+        word top = m_top.load(std::memory_order_relaxed);
+        do
+        {
+            tail->m_next.store(pointer(top), std::memory_order_relaxed);
+        } while (not m_top.compare_exchange_weak(top, replace(top, head), std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+
+    T* pop() noexcept
+    {
+        word top = m_top.load(std::memory_order_acquire);
+        while (lock_free_stack_hook* head = pointer(top))
+        {
+            if (untagged(top))
+            {
+                return pop_locked();
+            }
+            lock_free_stack_hook* next = head->m_next.load(std::memory_order_relaxed);
+            if (m_top.compare_exchange_weak(top, replace(top, next), std::memory_order_acquire,
+                                            std::memory_order_acquire))
+            {
+                return owner(head);
+            }
+        }
+        return nullptr;
+    }
+
+    // detaches every element at once, walk them with next()
+    T* pop_all() noexcept
+    {
+        word top = m_top.load(std::memory_order_acquire);
+        if (untagged(top))
+        {
+            lock_pop();
+            top = m_top.exchange(k_untagged, std::memory_order_acquire);
+            unlock_pop();
+            return owner(pointer(top));
+        }
+        while (pointer(top) && not m_top.compare_exchange_weak(top, replace(top, nullptr), std::memory_order_acquire,
+                                                               std::memory_order_acquire))
+        {
+            if (untagged(top))
+            {
+                return pop_all();
+            }
+        }
+        return owner(pointer(top));
+    }
+
+    bool empty() const noexcept
+    {
+        return pointer(m_top.load(std::memory_order_relaxed)) == nullptr;
+    }
+
+    // builds a chain for push_chain, or walks one returned by pop_all
+    static void link(T& val, T& next) noexcept
+    {
+        (val.*Hook).m_next.store(&(next.*Hook), std::memory_order_relaxed);
+    }
+
+    static T* next(T& val) noexcept
+    {
+        return owner((val.*Hook).m_next.load(std::memory_order_relaxed));
+    }
+
+private:
+    using word = std::uint64_t;
+
+    static constexpr inline unsigned k_tag_shift = sizeof(void*) == 8 ? 48 : 32;
+    static constexpr inline word k_pointer_mask = (word{1} << k_tag_shift) - 1;
+    static constexpr inline word k_untagged = 1;
+
+    static_assert(alignof(lock_free_stack_hook) > 1, "bit 0 of a hook address marks the untagged top");
+
+    static bool untagged(word w) noexcept
+    {
+        return (w & k_untagged) != 0;
+    }
+
+    // the word that makes p the new top after top; it stays tagged while every address fits
+    static word replace(word top, lock_free_stack_hook* p) noexcept
+    {
+        auto address = static_cast<word>(reinterpret_cast<std::uintptr_t>(p));
+        if (not untagged(top) && (address & ~k_pointer_mask) == 0)
+        {
+            return address | (((top >> k_tag_shift) + 1) << k_tag_shift);
+        }
+        return address | k_untagged;
+    }
+
+    static lock_free_stack_hook* pointer(word w) noexcept
+    {
+        auto address = untagged(w) ? w & ~k_untagged : w & k_pointer_mask;
+        return reinterpret_cast<lock_free_stack_hook*>(static_cast<std::uintptr_t>(address));
+    }
+
+    // untagged top: pops are serialized, a push in between only changes the top and fails the CAS
+    MLTS_COLD T* pop_locked() noexcept
+    {
+        lock_pop();
+        word top = m_top.load(std::memory_order_acquire);
+        lock_free_stack_hook* head = pointer(top);
+        while (head && not m_top.compare_exchange_weak(top, replace(top, head->m_next.load(std::memory_order_relaxed)),
+                                                       std::memory_order_acquire, std::memory_order_acquire))
+        {
+            head = pointer(top);
+        }
+        unlock_pop();
+        return owner(head);
+    }
+
+    void lock_pop() noexcept
+    {
+        for (std::uint32_t spin = 0; m_pop_lock.exchange(true, std::memory_order_acquire); ++spin)
+        {
+            if (spin >= 64)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock_pop() noexcept
+    {
+        m_pop_lock.store(false, std::memory_order_release);
+    }
+
+    static T* owner(lock_free_stack_hook* hook) noexcept
+    {
+        return hook ? detail::intrusive_owner<T, lock_free_stack_hook, Hook>(hook) : nullptr;
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<word> m_top{0};
+    std::atomic<bool> m_pop_lock{false};
+};
+
+} // namespace mlts
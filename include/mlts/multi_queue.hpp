@@ -0,0 +1,268 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/thread_random.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace mlts
+{
+
+// relaxed concurrent priority queue (MultiQueue): heap_count binary heaps, each behind a try-lock.
+// push goes to a random heap, pop takes the better top of two random heaps, so a pop returns one
+// of the best elements rather than the best one; with heap_count == 1 it is an exact priority queue.
+// Compare orders like std::priority_queue, with std::less the largest element comes out first.
+// try_pop only fails once it saw every heap empty
+template<typename T, typename Compare = std::less<T>>
+class multi_queue
+{
+    struct alignas(detail::k_machine_cache_line) heap
+    {
+        bool try_lock() noexcept
+        {
+            return not m_locked.load(std::memory_order_relaxed) &&
+                   not m_locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void lock() noexcept
+        {
+            for (std::uint32_t spin = 0; not try_lock(); ++spin)
+            {
+                backoff(spin);
+            }
+        }
+
+        void unlock() noexcept
+        {
+            m_locked.store(false, std::memory_order_release);
+        }
+
+        std::atomic<bool> m_locked{false};
+        // written under the lock, read without it to skip empty heaps
+        std::atomic<std::size_t> m_size{0};
+        std::vector<T> m_values{};
+    };
+
+public:
+    using value_type = T;
+
+    // heaps per hardware thread of the default heap count
+    static constexpr inline std::size_t k_heaps_per_thread = 2;
+
+    static std::size_t default_heap_count() noexcept
+    {
+        return k_heaps_per_thread * std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    explicit multi_queue(std::size_t heap_count = default_heap_count(), const Compare& comp = Compare())
+        : m_heaps(std::make_unique<heap[]>(std::max<std::size_t>(heap_count, 1)))
+        , m_heap_count(std::max<std::size_t>(heap_count, 1))
+        , m_comp(comp)
+    {
+        static_assert(std::atomic<std::size_t>::is_always_lock_free, "not support lock free");
+    }
+
+    multi_queue(const multi_queue&) = delete;
+    multi_queue& operator=(const multi_queue&) = delete;
+    multi_queue(multi_queue&&) noexcept = delete;
+    multi_queue& operator=(multi_queue&&) noexcept = delete;
+
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        heap* h = &m_heaps[random_index()];
+        for (std::uint32_t spin = 0; not h->try_lock(); ++spin)
+        {
+            // another heap is as good as this one, no point in waiting for its lock
+            backoff(spin);
+            h = &m_heaps[random_index()];
+        }
+        std::unique_lock<heap> lk(*h, std::adopt_lock);
+        h->m_values.emplace_back(std::forward<Args>(args)...);
+        try
+        {
+            sift_up(h->m_values);
+        }
+        catch (...)
+        {
+            // the new value is still at the back
+            h->m_values.pop_back();
+            throw;
+        }
+        h->m_size.store(h->m_values.size(), std::memory_order_relaxed);
+    }
+
+    void push(const T& value)
+    {
+        emplace(value);
+    }
+
+    void push(T&& value)
+    {
+        emplace(std::move(value));
+    }
+
+    bool try_pop(T& value)
+    {
+        for (std::size_t attempt = 0; attempt < k_pop_attempts; ++attempt)
+        {
+            heap* first = &m_heaps[random_index()];
+            heap* second = &m_heaps[random_index()];
+            if (not lock_non_empty(first))
+            {
+                first = std::exchange(second, nullptr);
+                if (not lock_non_empty(first))
+                {
+                    continue;
+                }
+            }
+            else if (second == first || not lock_non_empty(second))
+            {
+                second = nullptr;
+            }
+            // Compare and the move into value may throw, the heaps are unlocked either way
+            std::unique_lock<heap> first_lk(*first, std::adopt_lock);
+            std::unique_lock<heap> second_lk{};
+            if (second)
+            {
+                second_lk = std::unique_lock<heap>(*second, std::adopt_lock);
+            }
+            heap* best = second && m_comp(first->m_values.front(), second->m_values.front()) ? second : first;
+            take(*best, value);
+            return true;
+        }
+        // sampling kept missing, sweep every heap so an empty result means empty
+        auto start = random_index();
+        for (std::size_t i = 0; i < m_heap_count; ++i)
+        {
+            heap& h = m_heaps[(start + i) % m_heap_count];
+            if (h.m_size.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+            std::unique_lock<heap> lk(h);
+            if (not h.m_values.empty())
+            {
+                take(h, value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::optional<T> try_pop()
+    {
+        T value;
+        if (try_pop(value))
+        {
+            return value;
+        }
+        return {};
+    }
+
+    // any thread, may be stale by the time it returns
+    std::size_t size_approx() const noexcept
+    {
+        std::size_t size{0};
+        for (std::size_t i = 0; i < m_heap_count; ++i)
+        {
+            size += m_heaps[i].m_size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    bool empty() const noexcept
+    {
+        return size_approx() == 0;
+    }
+
+    std::size_t heap_count() const noexcept
+    {
+        return m_heap_count;
+    }
+
+private:
+    static constexpr inline std::size_t k_pop_attempts = 8;
+
+    bool lock_non_empty(heap* h) noexcept
+    {
+        if (h->m_size.load(std::memory_order_relaxed) == 0 || not h->try_lock())
+        {
+            return false;
+        }
+        if (h->m_values.empty())
+        {
+            h->unlock();
+            return false;
+        }
+        return true;
+    }
+
+    // push_heap that finds the new value's place before it moves anything, a throwing Compare
+    // leaves values as they were
+    void sift_up(std::vector<T>& values)
+    {
+        std::size_t hole = values.size() - 1;
+        std::size_t pos = hole;
+        while (pos > 0 && m_comp(values[(pos - 1) / 2], values.back()))
+        {
+            pos = (pos - 1) / 2;
+        }
+        if (pos == hole)
+        {
+            return;
+        }
+        T value = std::move(values.back());
+        for (; hole != pos; hole = (hole - 1) / 2)
+        {
+            values[hole] = std::move(values[(hole - 1) / 2]);
+        }
+        values[pos] = std::move(value);
+    }
+
+    // heap locked
+    void take(heap& h, T& value)
+    {
+        std::pop_heap(h.m_values.begin(), h.m_values.end(), m_comp);
+        try
+        {
+            value = std::move(h.m_values.back());
+        }
+        catch (...)
+        {
+            // the top stays in the heap
+            std::push_heap(h.m_values.begin(), h.m_values.end(), m_comp);
+            throw;
+        }
+        h.m_values.pop_back();
+        h.m_size.store(h.m_values.size(), std::memory_order_relaxed);
+    }
+
+    std::size_t random_index() const noexcept
+    {
+        return detail::thread_random_below(m_heap_count);
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= 64)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    std::unique_ptr<heap[]> m_heaps;
+    std::size_t m_heap_count;
+    Compare m_comp;
+};
+
+} // namespace mlts
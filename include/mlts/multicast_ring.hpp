@@ -0,0 +1,313 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/event_count.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace mlts
+{
+
+// position of the producer or of one consumer in a multicast_ring, -1 before the first event
+class ring_sequence
+{
+public:
+    static constexpr inline std::int64_t k_initial = -1;
+
+    std::int64_t get() const noexcept
+    {
+        return m_value.load(std::memory_order_acquire);
+    }
+
+    void set(std::int64_t value) noexcept
+    {
+        m_value.store(value, std::memory_order_release);
+    }
+
+private:
+    alignas(detail::k_machine_cache_line) std::atomic<std::int64_t> m_value{k_initial};
+};
+
+// wait strategies: wait(ready) returns once ready() is true, notify() is called after every
+// sequence update that someone may wait on
+
+// lowest latency, burns a core per waiting thread
+struct busy_spin_wait
+{
+    template<typename F>
+    void wait(F&& ready) noexcept(noexcept(ready()))
+    {
+        while (not ready())
+        {
+        }
+    }
+
+    void notify() noexcept
+    {
+    }
+};
+
+struct yielding_wait
+{
+    template<typename F>
+    void wait(F&& ready) noexcept(noexcept(ready()))
+    {
+        for (std::uint32_t spin = 0; not ready(); ++spin)
+        {
+            if (spin >= 64)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void notify() noexcept
+    {
+    }
+};
+
+// parks on an event_count after a short spin, notify costs a fence and a load while nobody sleeps
+struct blocking_wait
+{
+    template<typename F>
+    void wait(F&& ready)
+    {
+        for (std::uint32_t spin = 0; spin < 64; ++spin)
+        {
+            if (ready())
+            {
+                return;
+            }
+        }
+        while (1)
+        {
+            auto key = m_event.prepare_wait();
+            if (ready())
+            {
+                m_event.cancel_wait();
+                return;
+            }
+            m_event.wait(key);
+            if (ready())
+            {
+                return;
+            }
+        }
+    }
+
+    void notify() noexcept
+    {
+        m_event.notify_all();
+    }
+
+    detail::event_count m_event{};
+};
+
+// single producer, multiple consumer ring in the style of the LMAX disruptor: every consumer sees
+// every event. events are preallocated and updated in place, publishing never allocates.
+// each consumer tracks its own sequence and may depend on other consumers, it only sees an event
+// once all of them handled it, so later stages can read what earlier stages wrote into the event.
+// the producer waits for the slowest consumer before it reuses a slot.
+// consumers are added before the first publish
+template<typename T, typename Wait = yielding_wait>
+class multicast_ring
+{
+public:
+    using value_type = T;
+
+    class consumer
+    {
+    public:
+        consumer(multicast_ring& ring, std::initializer_list<const consumer*> deps) : m_ring(ring)
+        {
+            for (const consumer* dep : deps)
+            {
+                m_deps.push_back(&dep->m_sequence);
+            }
+            if (m_deps.empty())
+            {
+                m_deps.push_back(&ring.m_cursor);
+            }
+        }
+
+        consumer(const consumer&) = delete;
+        consumer& operator=(const consumer&) = delete;
+
+        // waits for events and handles all available ones as one batch, f(T&, sequence, end_of_batch).
+        // false once the ring is halted and everything published was handled
+        template<typename F>
+        bool process(F&& f)
+        {
+            auto next = m_sequence.get() + 1;
+            auto avail = ring_sequence::k_initial;
+            bool done{false};
+            m_ring.m_wait.wait([this, next, &avail, &done]() {
+                if (m_ring.m_halted.load(std::memory_order_acquire))
+                {
+                    avail = available();
+                    // halted after the last publish, deps that reached the cursor will not move again
+                    done = avail < next && avail == m_ring.m_cursor.get();
+                    return avail >= next || done;
+                }
+                avail = available();
+                return avail >= next;
+            });
+            if (done)
+            {
+                return false;
+            }
+            handle(next, avail, f);
+            return true;
+        }
+
+        // handles whatever is available without waiting, returns the number of events
+        template<typename F>
+        std::size_t try_process(F&& f)
+        {
+            auto next = m_sequence.get() + 1;
+            auto avail = available();
+            if (avail < next)
+            {
+                return 0;
+            }
+            handle(next, avail, f);
+            return static_cast<std::size_t>(avail - next + 1);
+        }
+
+        std::int64_t sequence() const noexcept
+        {
+            return m_sequence.get();
+        }
+
+    private:
+        friend class multicast_ring;
+
+        std::int64_t available() const noexcept
+        {
+            auto avail = std::numeric_limits<std::int64_t>::max();
+            for (const ring_sequence* dep : m_deps)
+            {
+                avail = std::min(avail, dep->get());
+            }
+            return avail;
+        }
+
+        template<typename F>
+        void handle(std::int64_t first, std::int64_t last, F& f)
+        {
+            for (auto seq = first; seq <= last; ++seq)
+            {
+                f(m_ring[seq], seq, seq == last);
+            }
+            m_sequence.set(last);
+            m_ring.m_wait.notify();
+        }
+
+        multicast_ring& m_ring;
+        ring_sequence m_sequence{};
+        std::vector<const ring_sequence*> m_deps{};
+    };
+
+    explicit multicast_ring(std::size_t capacity) : m_events(capacity), m_mask(capacity - 1)
+    {
+        static_assert(std::atomic<std::int64_t>::is_always_lock_free, "not support lock free");
+        assert(capacity != 0 && (capacity & (capacity - 1)) == 0 && "capacity must be a power of 2");
+    }
+
+    multicast_ring(const multicast_ring&) = delete;
+    multicast_ring& operator=(const multicast_ring&) = delete;
+    multicast_ring(multicast_ring&&) noexcept = delete;
+    multicast_ring& operator=(multicast_ring&&) noexcept = delete;
+
+    // deps are consumers that must handle an event first, none means it follows the producer
+    consumer& add_consumer(std::initializer_list<const consumer*> deps = {})
+    {
+        m_consumers.push_back(std::make_unique<consumer>(*this, deps));
+        return *m_consumers.back();
+    }
+
+    // producer only, claims the next slot, waits while the slowest consumer still needs it
+    std::int64_t next()
+    {
+        auto seq = m_next++;
+        auto wrap = seq - static_cast<std::int64_t>(capacity());
+        if (wrap > m_gating_cache)
+        {
+            m_wait.wait([this, wrap]() {
+                m_gating_cache = min_gating();
+                return wrap <= m_gating_cache;
+            });
+        }
+        return seq;
+    }
+
+    // producer only, makes the claimed slot and everything before it visible
+    void publish(std::int64_t seq) noexcept
+    {
+        m_cursor.set(seq);
+        m_wait.notify();
+    }
+
+    // producer only, f(T&) fills the slot in place
+    template<typename F>
+    std::int64_t publish_event(F&& f)
+    {
+        auto seq = next();
+        f((*this)[seq]);
+        publish(seq);
+        return seq;
+    }
+
+    T& operator[](std::int64_t seq) noexcept
+    {
+        return m_events[static_cast<std::size_t>(seq) & m_mask];
+    }
+
+    // wakes consumers waiting in process once the producer stopped publishing
+    void halt() noexcept
+    {
+        m_halted.store(true, std::memory_order_release);
+        m_wait.notify();
+    }
+
+    std::int64_t cursor() const noexcept
+    {
+        return m_cursor.get();
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        return m_mask + 1;
+    }
+
+private:
+    std::int64_t min_gating() const noexcept
+    {
+        auto min = m_cursor.get();
+        for (const auto& c : m_consumers)
+        {
+            min = std::min(min, c->m_sequence.get());
+        }
+        return min;
+    }
+
+    std::vector<T> m_events;
+    const std::size_t m_mask;
+    std::vector<std::unique_ptr<consumer>> m_consumers{};
+    // producer
+    ring_sequence m_cursor{};
+    std::int64_t m_next{0};
+    std::int64_t m_gating_cache{ring_sequence::k_initial};
+    alignas(detail::k_machine_cache_line) std::atomic<bool> m_halted{false};
+    Wait m_wait{};
+};
+
+} // namespace mlts
@@ -0,0 +1,91 @@
+#pragma once
+#include "detail/config.hpp"
+#include "epoch_domain.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+
+namespace mlts
+{
+
+// read-copy-update cell: readers visit the current value under an epoch guard, which writes only
+// the reader's own record, so there is no shared reference count to bounce between cores.
+// writers copy, edit and swap the pointer under a mutex and retire the old value to the domain,
+// it is freed once no reader that could have seen it is still inside a guard
+template<typename T>
+class rcu_cell
+{
+public:
+    using value_type = T;
+
+    rcu_cell() : rcu_cell(T{})
+    {
+    }
+
+    explicit rcu_cell(T value, epoch_domain& domain = epoch_domain::global())
+        : m_domain(domain), m_value(new T(std::move(value)))
+    {
+        static_assert(std::atomic<T*>::is_always_lock_free, "not support lock free");
+    }
+
+    // no other thread may use the cell, values already retired are freed by the domain
+    ~rcu_cell()
+    {
+        delete m_value.load(std::memory_order_relaxed);
+    }
+
+    rcu_cell(const rcu_cell&) = delete;
+    rcu_cell& operator=(const rcu_cell&) = delete;
+    rcu_cell(rcu_cell&&) noexcept = delete;
+    rcu_cell& operator=(rcu_cell&&) noexcept = delete;
+
+    // f(const T&) sees one consistent value, which stays alive until f returns; the result is
+    // returned by value, a reference into the value could be reclaimed once the guard is left
+    template<typename F>
+    std::decay_t<std::invoke_result_t<F&, const T&>> read(F&& f) const
+    {
+        epoch_domain::guard g(m_domain);
+        return std::invoke(f, std::as_const(*m_value.load(std::memory_order_acquire)));
+    }
+
+    T load() const
+    {
+        return read([](const T& value) { return value; });
+    }
+
+    // f(T&) edits a copy of the current value, readers see the copy once f returned;
+    // the current value stays if f throws
+    template<typename F>
+    void update(F&& f)
+    {
+        std::scoped_lock lk(m_mu);
+        auto next = std::make_unique<T>(*m_value.load(std::memory_order_relaxed));
+        std::invoke(f, *next);
+        swap_in(next.release());
+    }
+
+    void store(T value)
+    {
+        auto next = std::make_unique<T>(std::move(value));
+        std::scoped_lock lk(m_mu);
+        swap_in(next.release());
+    }
+
+private:
+    // mutex held
+    void swap_in(T* next)
+    {
+        T* old = m_value.exchange(next, std::memory_order_acq_rel);
+        m_domain.retire(old);
+    }
+
+    epoch_domain& m_domain;
+    std::mutex m_mu{};
+    alignas(detail::k_machine_cache_line) std::atomic<T*> m_value;
+};
+
+} // namespace mlts
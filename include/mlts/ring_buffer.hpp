@@ -1,4 +1,10 @@
 #pragma once
+#include "detail/config.hpp"
+#include "detail/queue_stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <optional>
@@ -21,8 +27,8 @@ public:
 
     ~ring_buffer()
     {
-        auto in = m_in & m_mask;
-        auto out = m_out & m_mask;
+        auto in = m_in.load(std::memory_order_relaxed) & m_mask;
+        auto out = m_out.load(std::memory_order_relaxed) & m_mask;
         for (; out != in; out = (out + 1) & m_mask)
         {
             std::destroy_at(&m_buf[out]);
@@ -68,54 +74,75 @@ public:
     size_t put(T* values, size_t len)
     {
         std::lock_guard lk(m_mu);
-        len = std::min(len, capacity() - m_in + m_out);
+        auto in = m_in.load(std::memory_order_relaxed);
+        auto out = m_out.load(std::memory_order_relaxed);
+        len = std::min(len, capacity() - in + out);
 
-        size_t l = std::min(len, capacity() - (m_in & m_mask));
+        size_t l = std::min(len, capacity() - (in & m_mask));
         for (size_t i = 0; i < l; ++i)
         {
-            std::construct_at<T>(&m_buf[i + (m_in & m_mask)], std::move(values[i]));
+            std::construct_at<T>(&m_buf[i + (in & m_mask)], std::move(values[i]));
         }
 
         size_t rl = len - l;
         for (size_t i = 0; i < rl; ++i)
         {
-            m_buf[i] = std::move(values[i + l]);
+            std::construct_at<T>(&m_buf[i], std::move(values[i + l]));
         }
 
-        m_in += len;
-
+        m_in.store(in + len, std::memory_order_relaxed);
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(in + len - out);
+        }
         return len;
     }
 
     size_t get(T* values, size_t len)
     {
         std::lock_guard lk(m_mu);
-        len = std::min(len, m_in - m_out);
-        size_t l = std::min(len, capacity() - (m_out & m_mask));
+        auto in = m_in.load(std::memory_order_relaxed);
+        auto out = m_out.load(std::memory_order_relaxed);
+        len = std::min(len, in - out);
+        size_t l = std::min(len, capacity() - (out & m_mask));
         for (size_t i = 0; i < l; ++i)
         {
-            values[i] = std::move(m_buf[i + (m_out & m_mask)]);
+            values[i] = std::move(m_buf[i + (out & m_mask)]);
+            std::destroy_at(&m_buf[i + (out & m_mask)]);
         }
 
         size_t rl = len - l;
         for (size_t i = 0; i < rl; ++i)
         {
             values[l + i] = std::move(m_buf[i]);
+            std::destroy_at(&m_buf[i]);
         }
-        m_out += len;
+        m_out.store(out + len, std::memory_order_relaxed);
         return len;
     }
 
     size_t exist_len() const
     {
         std::lock_guard lk(m_mu);
-        return m_in - m_out;
+        return m_in.load(std::memory_order_relaxed) - m_out.load(std::memory_order_relaxed);
     }
 
     size_t empty_len() const
     {
         std::lock_guard lk(m_mu);
-        return m_mask + 1 - m_in + m_out;
+        return m_mask + 1 - m_in.load(std::memory_order_relaxed) + m_out.load(std::memory_order_relaxed);
+    }
+
+    // no lock, the counters are written under the mutex and read relaxed, may be stale
+    size_t size_approx() const noexcept
+    {
+        auto out = m_out.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_in.load(std::memory_order_relaxed), out);
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_in.load(std::memory_order_relaxed), m_out.load(std::memory_order_relaxed), m_high_water.value()};
     }
 
     size_t capacity() const noexcept
@@ -125,13 +152,14 @@ public:
 
     bool empty() const
     {
-        return !empty_len();
+        return size_approx() == 0;
     }
 
 private:
-    size_t m_in{};
-    size_t m_out{};
-    const size_t m_mask;
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_in{};
+    detail::queue_high_water m_high_water{};
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_out{};
+    alignas(detail::k_machine_cache_line) const size_t m_mask;
     T* m_buf{};
     mutable std::mutex m_mu{};
     static constexpr inline size_t esize = sizeof(T);
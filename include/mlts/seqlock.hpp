@@ -0,0 +1,170 @@
+#pragma once
+#include "detail/config.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <type_traits>
+
+
+namespace mlts
+{
+
+// sequence lock around a small trivially copyable value: readers copy the value out and retry
+// when a write overlapped, they only load shared memory and never write it, so any number of
+// readers run without bouncing a cache line. writers take the sequence odd while they write and
+// exclude each other on it. the value lives in relaxed atomic words, a torn copy is discarded
+// instead of being a data race
+template<typename T>
+class seqlock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "seqlock copies the value bytewise");
+
+public:
+    using value_type = T;
+
+    seqlock() noexcept(std::is_nothrow_default_constructible_v<T>) : seqlock(T{})
+    {
+    }
+
+    explicit seqlock(const T& value) noexcept
+    {
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "not support lock free");
+        write_words(value);
+    }
+
+    seqlock(const seqlock&) = delete;
+    seqlock& operator=(const seqlock&) = delete;
+    seqlock(seqlock&&) noexcept = delete;
+    seqlock& operator=(seqlock&&) noexcept = delete;
+
+    T load() const noexcept
+    {
+        std::array<unsigned char, sizeof(T)> bytes;
+        for (std::uint32_t spin = 0;; ++spin)
+        {
+            auto seq = m_seq.load(std::memory_order_acquire);
+            if ((seq & 1) == 0)
+            {
+                read_words(bytes);
+                // the copy is complete before the sequence is checked again
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_seq.load(std::memory_order_relaxed) == seq)
+                {
+                    return std::bit_cast<T>(bytes);
+                }
+            }
+            backoff(spin);
+        }
+    }
+
+    // false when a write was in progress or overlapped the copy
+    bool try_load(T& value) const noexcept
+    {
+        auto seq = m_seq.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+            return false;
+        }
+        std::array<unsigned char, sizeof(T)> bytes;
+        read_words(bytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) != seq)
+        {
+            return false;
+        }
+        value = std::bit_cast<T>(bytes);
+        return true;
+    }
+
+    void store(const T& value) noexcept
+    {
+        auto seq = lock();
+        write_words(value);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // f(T&) edits a copy of the current value, other writers wait until it is stored
+    template<typename F>
+    void update(F&& f)
+    {
+        auto seq = lock();
+        std::array<unsigned char, sizeof(T)> bytes;
+        read_words(bytes);
+        T value = std::bit_cast<T>(bytes);
+        try
+        {
+            std::invoke(f, value);
+        }
+        catch (...)
+        {
+            // nothing was written, readers may keep the value they copy
+            m_seq.store(seq, std::memory_order_release);
+            throw;
+        }
+        write_words(value);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // even while no write is in progress, grows by 2 per write
+    std::uint64_t sequence() const noexcept
+    {
+        return m_seq.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr inline std::size_t k_words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    std::uint64_t lock() noexcept
+    {
+        for (std::uint32_t spin = 0;; ++spin)
+        {
+            auto seq = m_seq.load(std::memory_order_relaxed);
+            if ((seq & 1) == 0 && m_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                                              std::memory_order_relaxed))
+            {
+                // readers that see a word of this write also see the odd sequence
+                std::atomic_thread_fence(std::memory_order_release);
+                return seq;
+            }
+            backoff(spin);
+        }
+    }
+
+    void read_words(std::array<unsigned char, sizeof(T)>& bytes) const noexcept
+    {
+        std::array<std::uint64_t, k_words> words;
+        for (std::size_t i = 0; i < k_words; ++i)
+        {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        std::memcpy(bytes.data(), words.data(), sizeof(T));
+    }
+
+    void write_words(const T& value) noexcept
+    {
+        std::array<std::uint64_t, k_words> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        for (std::size_t i = 0; i < k_words; ++i)
+        {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    static void backoff(std::uint32_t spin) noexcept
+    {
+        if (spin >= 64)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    alignas(detail::k_machine_cache_line) std::atomic<std::uint64_t> m_seq{0};
+    std::atomic<std::uint64_t> m_words[k_words]{};
+};
+
+} // namespace mlts
@@ -0,0 +1,203 @@
+#pragma once
+#include "detail/config.hpp"
+#include "detail/queue_stats.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace mlts
+{
+
+// unbounded single producer, single consumer queue of fixed size blocks. push is a plain store
+// plus one release of the producer counter, a block is only allocated every BlockSize elements.
+// each side caches the other's position: the consumer rereads the producer counter only when it
+// caught up with its copy, the producer rereads the consumer's block only when it needs a block.
+// blocks the consumer left stay in the chain and are reused by the producer
+template<typename T, std::size_t BlockSize = 256>
+class spsc_queue
+{
+    static_assert(BlockSize >= 2 && (BlockSize & (BlockSize - 1)) == 0, "block size must be a power of 2");
+
+    struct block
+    {
+        T* slot(std::size_t idx) noexcept
+        {
+            return std::launder(reinterpret_cast<T*>(m_storage + idx * sizeof(T)));
+        }
+
+        alignas(alignof(T)) std::byte m_storage[sizeof(T) * BlockSize];
+        // written by the producer before the counter that makes the last slot visible
+        block* m_next{nullptr};
+    };
+
+public:
+    using value_type = T;
+
+    spsc_queue() : m_tail(new block), m_first(m_tail), m_head_cache(m_tail), m_head(m_tail), m_head_local(m_tail)
+    {
+        static_assert(std::atomic<size_t>::is_always_lock_free, "not support lock free");
+    }
+
+    ~spsc_queue()
+    {
+        while (front())
+        {
+            pop_front();
+        }
+        while (m_first)
+        {
+            block* next = m_first->m_next;
+            delete m_first;
+            m_first = next;
+        }
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+    spsc_queue(spsc_queue&&) noexcept = delete;
+    spsc_queue& operator=(spsc_queue&&) noexcept = delete;
+
+    // producer only
+    template<typename... Args>
+    void emplace(Args&&... args)
+    {
+        auto in = m_in.load(std::memory_order_relaxed);
+        auto idx = in & k_mask;
+        T* p = std::construct_at(m_tail->slot(idx), std::forward<Args>(args)...);
+        if (idx == k_mask)
+        {
+            // link the next block before the last slot is published, the consumer never waits on it
+            try
+            {
+                block* next = acquire_block();
+                m_tail->m_next = next;
+                m_tail = next;
+            }
+            catch (...)
+            {
+                std::destroy_at(p);
+                throw;
+            }
+        }
+        m_in.store(in + 1, std::memory_order_release);
+        if constexpr (detail::queue_high_water::enabled())
+        {
+            m_high_water.update(in + 1 - m_out.load(std::memory_order_relaxed));
+        }
+    }
+
+    // producer only
+    void push(const T& value)
+    {
+        emplace(value);
+    }
+
+    void push(T&& value)
+    {
+        emplace(std::move(value));
+    }
+
+    // consumer only, the oldest element or nullptr when empty; valid until pop_front
+    T* front() noexcept
+    {
+        auto out = m_out.load(std::memory_order_relaxed);
+        if (out == m_in_cache)
+        {
+            m_in_cache = m_in.load(std::memory_order_acquire);
+            if (out == m_in_cache)
+            {
+                return nullptr;
+            }
+        }
+        return m_head_local->slot(out & k_mask);
+    }
+
+    // consumer only, front() must have returned an element
+    void pop_front() noexcept
+    {
+        auto out = m_out.load(std::memory_order_relaxed);
+        auto idx = out & k_mask;
+        std::destroy_at(m_head_local->slot(idx));
+        if (idx == k_mask)
+        {
+            // the block is drained, handing it back lets the producer reuse it
+            m_head_local = m_head_local->m_next;
+            m_head.store(m_head_local, std::memory_order_release);
+        }
+        m_out.store(out + 1, std::memory_order_release);
+    }
+
+    // consumer only
+    bool try_pop(T& value) noexcept(std::is_nothrow_move_assignable_v<T>)
+    {
+        T* p = front();
+        if (p == nullptr)
+        {
+            return false;
+        }
+        value = std::move(*p);
+        pop_front();
+        return true;
+    }
+
+    // consumer only
+    bool empty() noexcept
+    {
+        return front() == nullptr;
+    }
+
+    // any thread, may be stale by the time it returns
+    size_t size_approx() const noexcept
+    {
+        auto out = m_out.load(std::memory_order_relaxed);
+        return detail::queue_size_approx(m_in.load(std::memory_order_relaxed), out);
+    }
+
+    queue_stats stats() const noexcept
+    {
+        return {m_in.load(std::memory_order_relaxed), m_out.load(std::memory_order_relaxed), m_high_water.value()};
+    }
+
+    static constexpr size_t block_size() noexcept
+    {
+        return BlockSize;
+    }
+
+private:
+    static constexpr inline std::size_t k_mask = BlockSize - 1;
+
+    // blocks from m_first up to the consumer's block are drained
+    block* acquire_block()
+    {
+        if (m_first == m_head_cache)
+        {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (m_first == m_head_cache)
+            {
+                return new block;
+            }
+        }
+        block* b = m_first;
+        m_first = b->m_next;
+        b->m_next = nullptr;
+        return b;
+    }
+
+    // producer
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_in{0};
+    block* m_tail;
+    block* m_first;
+    block* m_head_cache;
+    detail::queue_high_water m_high_water{};
+    // consumer
+    alignas(detail::k_machine_cache_line) std::atomic<size_t> m_out{0};
+    std::atomic<block*> m_head;
+    block* m_head_local;
+    size_t m_in_cache{0};
+};
+
+} // namespace mlts
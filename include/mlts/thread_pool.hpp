@@ -1,17 +1,53 @@
 #pragma once
+#include "allocator.hpp"
 #include "define_type.hpp"
+#include "detail/fork_task.hpp"
+#include "detail/reclaim.hpp"
+#include "function.hpp"
 #include "get_index_policy.hpp"
 #include "lock_free_queue.hpp"
+#include "timer.hpp"
+#include "work_stealing_deque.hpp"
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <concepts>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
 
 namespace mlts
 {
 
-template<typename TFunc = std::function<void()>, typename TQueue = lock_free_queue<TFunc>>
+// tasks live inside their queue node, with the default task size the node of a
+// lock_free_queue fits one cache line and captures up to 40 bytes never touch the heap
+constexpr inline size_t k_thread_pool_task_size = 40;
+
+static_assert(sizeof(lock_free_queue_node<function<void(), k_thread_pool_task_size>>) <= detail::k_machine_cache_line,
+              "default thread_pool task node spans more than one cache line");
+
+template<typename TFunc = function<void(), k_thread_pool_task_size>>
+struct thread_pool_policy
+{
+    using task_type = TFunc;
+    using queue_type = lock_free_queue<task_type, mp_sc_recycle_allocator<lock_free_queue_node<task_type>>>;
+};
+
+template<typename TQueue, typename TFunc>
+concept thread_pool_queue = std::default_initializable<TQueue> && requires(TQueue& queue, TFunc& task) {
+    queue.push(std::move(task));
+    { queue.pop(task) } -> std::convertible_to<bool>;
+};
+
+template<typename TFunc = typename thread_pool_policy<>::task_type,
+         typename TQueue = typename thread_pool_policy<TFunc>::queue_type>
+    requires std::invocable<TFunc&> && std::default_initializable<TFunc> && thread_pool_queue<TQueue, TFunc>
 class thread_pool
 {
     enum class thread_state : int
@@ -22,14 +58,80 @@ class thread_pool
         wait,
     };
 
+    enum class close_state : int
+    {
+        running,
+        drain,
+        abort,
+    };
+
     using function = TFunc;
 
+public:
+    using exception_handler = std::function<void(std::exception_ptr)>;
+    using fork_deque = work_stealing_deque<detail::fork_task*>;
+
+    enum class shutdown_mode : int
+    {
+        // run every queued task, then stop
+        drain,
+        // destroy queued tasks without running them, each worker drops its own queue
+        abort,
+    };
+
+    struct shutdown_report
+    {
+        std::chrono::nanoseconds elapsed{};
+        size_t dropped{0};
+        bool timeout{false};
+    };
+
+private:
+    struct thread;
+
+    // shared by the pool and its workers, lives on the heap so the pool stays movable
+    struct pool_context
+    {
+        MLTS_COLD void on_exception(std::exception_ptr e) noexcept
+        {
+            m_exception_count.fetch_add(1, std::memory_order_relaxed);
+            exception_handler handler{};
+            {
+                std::scoped_lock lk(m_mu);
+                handler = m_handler;
+            }
+            if (not handler)
+            {
+                return;
+            }
+            try
+            {
+                handler(std::move(e));
+            }
+            catch (...)
+            {
+            }
+        }
+
+        std::mutex m_mu{};
+        exception_handler m_handler{};
+        std::atomic<size_t> m_exception_count{0};
+        // set by shutdown, pushes are rejected from then on
+        std::atomic<bool> m_is_closed{false};
+        // filled before any worker starts, read by workers looking for fork tasks to steal
+        std::unique_ptr<std::atomic<thread*>[]> m_workers{};
+        size_t m_worker_size{0};
+    };
+
     struct thread
     {
-        explicit thread(thread_state state, size_t idle_count_max)
-            : m_state(std::make_unique<std::atomic<thread_state>>()),
-              m_queue(std::make_unique<lock_free_queue<function>>()), m_idle_count_max(idle_count_max), m_idle_count(0),
-              m_yield_count(0), m_wait_count(0), m_is_close(std::make_unique<std::atomic<bool>>(false)),
+        explicit thread(pool_context* context, size_t index, thread_state state, size_t idle_count_max)
+            : m_context(context), m_index(index), m_state(std::make_unique<std::atomic<thread_state>>()),
+              m_queue(std::make_unique<TQueue>()), m_deque(std::make_unique<fork_deque>()),
+              m_idle_count_max(idle_count_max), m_idle_count(0),
+              m_yield_count(0), m_wait_count(0), m_dropped(0),
+              m_is_close(std::make_unique<std::atomic<close_state>>(close_state::running)),
+              m_is_done(std::make_unique<std::atomic<bool>>(false)),
               m_is_wait(std::make_unique<std::atomic<bool>>(false)),
               m_ins(std::make_unique<std::thread>([this]() { work(); }))
         {
@@ -37,13 +139,11 @@ class thread_pool
 
         ~thread()
         {
-            m_is_close->store(true);
-            m_is_wait->store(false, std::memory_order_release);
-            m_is_wait->notify_all();
             if (m_ins)
             {
                 if (m_ins->joinable())
                 {
+                    stop(close_state::drain);
                     m_ins->join();
                 }
             }
@@ -64,17 +164,91 @@ class thread_pool
             bool ret = m_queue->pop(f);
             if (ret) [[likely]]
             {
-                f();
+                try
+                {
+                    f();
+                }
+                catch (...)
+                {
+                    m_context->on_exception(std::current_exception());
+                }
+            }
+            return ret;
+        }
+
+        bool steal_one()
+        {
+            size_t size = m_context->m_worker_size;
+            for (size_t i = 1; i < size; ++i)
+            {
+                thread* victim = m_context->m_workers[(m_index + i) % size].load(std::memory_order_acquire);
+                detail::fork_task* task{};
+                if (victim && victim->m_deque->steal(task))
+                {
+                    task->run();
+                    return true;
+                }
             }
+            return false;
+        }
+
+        bool run_one_or_steal()
+        {
+            bool ret = run_one() || steal_one();
+            // amortised reclamation point for objects retired by tasks on this worker
+            quiescent_state();
             return ret;
         }
 
+        // never lowers abort back to drain
+        void stop(close_state state)
+        {
+            auto old = m_is_close->load();
+            while (old < state && not m_is_close->compare_exchange_weak(old, state))
+            {
+            }
+            m_is_wait->store(false);
+            m_is_wait->notify_all();
+        }
+
+        void join()
+        {
+            if (m_ins && m_ins->joinable())
+            {
+                m_ins->join();
+            }
+        }
+
+        void finish()
+        {
+            while (m_is_close->load(std::memory_order_relaxed) == close_state::drain)
+            {
+                if (not run_one())
+                {
+                    break;
+                }
+            }
+            if (m_is_close->load(std::memory_order_relaxed) == close_state::abort)
+            {
+                function f;
+                while (m_queue->pop(f))
+                {
+                    ++m_dropped;
+                }
+            }
+            m_is_wait->store(true, std::memory_order_release);
+            m_is_wait->notify_all();
+            m_is_done->store(true, std::memory_order_release);
+        }
+
         void work()
         {
+            s_current = this;
             while (1)
             {
-                if (m_is_close->load(std::memory_order_relaxed)) [[unlikely]]
+                if (m_is_close->load() != close_state::running) [[unlikely]]
                 {
+                    finish();
                     return;
                 }
 
@@ -82,7 +256,7 @@ class thread_pool
                 {
                 case thread_state::normal: {
 
-                    if (run_one()) [[likely]]
+                    if (run_one_or_steal()) [[likely]]
                     {
                         continue;
                     }
@@ -101,7 +275,7 @@ class thread_pool
                         m_yield_count = 0;
                         m_state->store(thread_state::yield, std::memory_order_relaxed);
                     }
-                    if (run_one())
+                    if (run_one_or_steal())
                     {
                         m_yield_count = 0;
                         m_state->store(thread_state::normal, std::memory_order_relaxed);
@@ -118,11 +292,11 @@ class thread_pool
                     if (m_wait_count >= m_idle_count_max)
                     {
                         m_wait_count = 0;
-                        m_is_wait->store(true, std::memory_order_release);
+                        m_is_wait->store(true);
                         m_is_wait->notify_all();
                         m_state->store(thread_state::wait, std::memory_order_relaxed);
                     }
-                    if (run_one())
+                    if (run_one_or_steal())
                     {
                         m_wait_count = 0;
                         m_state->store(thread_state::normal, std::memory_order_relaxed);
@@ -138,11 +312,19 @@ class thread_pool
 
                 case thread_state::wait: {
                     m_is_wait->wait(true, std::memory_order_acquire);
-                    if (run_one())
+                    if (not run_one_or_steal())
                     {
-                        m_is_wait->store(false, std::memory_order_release);
-                        m_state->store(thread_state::normal, std::memory_order_relaxed);
+                        // woken without work, sleep again unless a task raced in after the flag was set
+                        m_is_wait->store(true);
+                        m_is_wait->notify_all();
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (not run_one_or_steal())
+                        {
+                            continue;
+                        }
                     }
+                    m_is_wait->store(false, std::memory_order_release);
+                    m_state->store(thread_state::normal, std::memory_order_relaxed);
                     continue;
                     break;
                 }
@@ -158,36 +340,45 @@ class thread_pool
             m_is_wait->notify_all();
         }
 
+        static inline thread_local thread* s_current{nullptr};
+
+        pool_context* m_context;
+        size_t m_index;
         std::unique_ptr<std::atomic<thread_state>> m_state;
         std::unique_ptr<TQueue> m_queue;
+        std::unique_ptr<fork_deque> m_deque;
         size_t m_idle_count_max;
         size_t m_idle_count;
         size_t m_yield_count;
         size_t m_wait_count;
-        std::unique_ptr<std::atomic<bool>> m_is_close;
+        size_t m_dropped;
+        std::unique_ptr<std::atomic<close_state>> m_is_close;
+        std::unique_ptr<std::atomic<bool>> m_is_done;
         std::unique_ptr<std::atomic<bool>> m_is_wait;
         std::unique_ptr<std::thread> m_ins;
     };
 
 public:
     thread_pool(size_t thread_size = 4, size_t idle_count_max = 1000)
-        : m_index_policy(thread_size), m_idle_count_max(idle_count_max)
+        : m_index_policy(thread_size), m_idle_count_max(idle_count_max), m_context(std::make_unique<pool_context>())
     {
-        for (size_t i = 0; i < thread_size; ++i)
-        {
-            auto th = std::make_unique<thread>(thread_state::normal, idle_count_max);
-            m_threads.emplace_back(std::move(th));
-        }
+        start(thread_size);
+    }
+
+    ~thread_pool()
+    {
+        shutdown(shutdown_mode::drain);
     }
 
-    ~thread_pool() = default;
     thread_pool(const thread_pool&) = delete;
     thread_pool& operator=(const thread_pool& other) = delete;
     thread_pool(thread_pool&&) noexcept = default;
     thread_pool& operator=(thread_pool&&) noexcept = default;
 
+    // false when the pool is shut down, the task is then destroyed without running;
+    // a push racing with shutdown may be accepted and still be dropped, shutdown counts it
     template<typename Func>
-    void push_func(Func&& f)
+    bool push_func(Func&& f)
     {
         // for (auto& thp : m_threads)
         // {
@@ -198,17 +389,57 @@ public:
         //         return;
         //     }
         // }
+        if (m_context->m_is_closed.load(std::memory_order_acquire)) [[unlikely]]
+        {
+            return false;
+        }
         auto& thp = m_threads.at(m_index_policy.get_index());
         auto& th = *thp;
         th.add_task(std::forward<Func>(f));
+        return true;
     }
 
     template<typename Func>
-    void push_func(size_t index, Func&& f)
+    bool push_func(size_t index, Func&& f)
     {
+        if (m_context->m_is_closed.load(std::memory_order_acquire)) [[unlikely]]
+        {
+            return false;
+        }
         auto& thp = m_threads.at(index);
         auto& th = *thp;
         th.add_task(std::forward<Func>(f));
+        return true;
+    }
+
+    // the task's result or exception is delivered through the returned future,
+    // after shutdown the future holds a std::future_error with future_errc::broken_promise
+    template<typename Func>
+    auto submit(Func&& f) -> std::future<std::invoke_result_t<std::decay_t<Func>>>
+    {
+        using result_type = std::invoke_result_t<std::decay_t<Func>>;
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<Func>(f));
+        auto fut = task->get_future();
+        push_func([task = std::move(task)]() { (*task)(); });
+        return fut;
+    }
+
+    bool is_closed() const noexcept
+    {
+        return m_context->m_is_closed.load(std::memory_order_acquire);
+    }
+
+    // called on the worker thread for every exception escaping a task pushed by push_func,
+    // exceptions are dropped (and only counted) when no handler is set
+    void set_exception_handler(exception_handler handler)
+    {
+        std::scoped_lock lk(m_context->m_mu);
+        m_context->m_handler = std::move(handler);
+    }
+
+    size_t exception_count() const noexcept
+    {
+        return m_context->m_exception_count.load(std::memory_order_relaxed);
     }
 
     void wait_done() const
@@ -225,6 +456,68 @@ public:
         }
     }
 
+    // stops every worker and joins it, tasks pushed after shutdown are rejected;
+    // the workers stay allocated until the pool is destroyed or reset
+    shutdown_report shutdown(shutdown_mode mode = shutdown_mode::drain)
+    {
+        timer ti{};
+        ti.start();
+        close();
+        for (auto& thp : m_threads)
+        {
+            thp->stop(mode == shutdown_mode::drain ? close_state::drain : close_state::abort);
+        }
+        shutdown_report report{};
+        report.dropped = join_all();
+        ti.end();
+        report.elapsed = ti.elapsed_time<std::chrono::nanoseconds>();
+        return report;
+    }
+
+    // drains until the timeout expires, then aborts whatever is still queued;
+    // a task that is already running is always allowed to finish
+    template<typename Rep, typename Period>
+    shutdown_report shutdown_for(std::chrono::duration<Rep, Period> timeout)
+    {
+        timer ti{};
+        ti.start();
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        close();
+        for (auto& thp : m_threads)
+        {
+            thp->stop(close_state::drain);
+        }
+
+        shutdown_report report{};
+        for (auto& thp : m_threads)
+        {
+            while (not thp->m_is_done->load(std::memory_order_acquire))
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    report.timeout = true;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            if (report.timeout)
+            {
+                break;
+            }
+        }
+        if (report.timeout)
+        {
+            for (auto& thp : m_threads)
+            {
+                thp->stop(close_state::abort);
+            }
+        }
+        report.dropped = join_all();
+        ti.end();
+        report.elapsed = ti.elapsed_time<std::chrono::nanoseconds>();
+        return report;
+    }
+
     void reset(size_t count)
     {
         if (count == 0)
@@ -233,19 +526,105 @@ public:
         }
         get_index_policy new_policy(count);
         m_index_policy = std::move(new_policy);
+        // no push may race with reset
+        shutdown(shutdown_mode::drain);
         m_threads.clear();
+        start(count);
+        m_context->m_is_closed.store(false, std::memory_order_release);
+    }
+
+    // fork/join support for fork_scope, the deque of the calling worker or nullptr off the pool
+    fork_deque* local_fork_deque() const noexcept
+    {
+        thread* current = thread::s_current;
+        if (current && current->m_context == m_context.get())
+        {
+            return current->m_deque.get();
+        }
+        return nullptr;
+    }
+
+    // steals one fork task from the other workers and runs it, only on a worker of this pool:
+    // a task stolen by an outside thread would push its own children into the worker queues
+    bool help_fork()
+    {
+        thread* current = thread::s_current;
+        if (current && current->m_context == m_context.get())
+        {
+            return current->steal_one();
+        }
+        return false;
+    }
+
+    // wakes one parked worker so it can steal a freshly spawned fork task
+    void notify_fork() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0; i < m_context->m_worker_size; ++i)
+        {
+            thread* th = m_context->m_workers[i].load(std::memory_order_relaxed);
+            if (th && th->m_is_wait->load(std::memory_order_relaxed))
+            {
+                th->m_is_wait->store(false, std::memory_order_release);
+                th->m_is_wait->notify_all();
+                return;
+            }
+        }
+    }
+
+private:
+    // a moved-from pool has no context and no workers
+    void close() noexcept
+    {
+        if (m_context)
+        {
+            m_context->m_is_closed.store(true, std::memory_order_release);
+        }
+    }
+
+    void start(size_t count)
+    {
+        m_context->m_workers = std::make_unique<std::atomic<thread*>[]>(count);
+        m_context->m_worker_size = count;
         for (size_t i = 0; i < count; ++i)
         {
-            auto th = std::make_unique<thread>(thread_state::normal, m_idle_count_max);
+            auto th = std::make_unique<thread>(m_context.get(), i, thread_state::normal, m_idle_count_max);
+            m_context->m_workers[i].store(th.get(), std::memory_order_release);
             m_threads.emplace_back(std::move(th));
         }
     }
 
-private:
+    size_t join_all()
+    {
+        size_t dropped{0};
+        for (auto& thp : m_threads)
+        {
+            thp->join();
+            // tasks of pushes that raced with shutdown, the worker is gone so this thread consumes
+            function f;
+            while (thp->m_queue->pop(f))
+            {
+                ++thp->m_dropped;
+            }
+            dropped += std::exchange(thp->m_dropped, 0);
+        }
+        if (m_context)
+        {
+            for (size_t i = 0; i < m_context->m_worker_size; ++i)
+            {
+                m_context->m_workers[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        return dropped;
+    }
+
     std::vector<std::unique_ptr<thread>> m_threads;
     get_index_policy m_index_policy;
     size_t m_idle_count_max;
+    std::unique_ptr<pool_context> m_context;
 };
 
+template<typename TPolicy>
+using thread_pool_for = thread_pool<typename TPolicy::task_type, typename TPolicy::queue_type>;
 
-} // namespace mlts
+} // namespace mlts
\ No newline at end of file
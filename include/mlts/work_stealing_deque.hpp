@@ -0,0 +1,105 @@
+#pragma once
+#include "detail/config.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+
+namespace mlts
+{
+
+// bounded Chase-Lev deque, the owner pushes and pops at the bottom, other threads steal from the top
+template<typename T, std::size_t Capacity = 1024>
+class work_stealing_deque
+{
+    static_assert(std::has_single_bit(Capacity), "capacity need power of two");
+    static_assert(std::atomic<T>::is_always_lock_free, "not support lock free");
+
+public:
+    using value_type = T;
+
+    work_stealing_deque() = default;
+    ~work_stealing_deque() = default;
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+    work_stealing_deque(work_stealing_deque&&) noexcept = delete;
+    work_stealing_deque& operator=(work_stealing_deque&&) noexcept = delete;
+
+    // owner only, returns false when full
+    bool push(T val) noexcept
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t >= static_cast<std::int64_t>(Capacity)) [[unlikely]]
+        {
+            return false;
+        }
+        m_buffer[b & k_mask].store(val, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only
+    bool pop(T& val) noexcept
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        val = m_buffer[b & k_mask].load(std::memory_order_relaxed);
+        if (t != b) [[likely]]
+        {
+            return true;
+        }
+
+        // last element, race against the thieves for it
+        bool ret = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return ret;
+    }
+
+    // any thread
+    bool steal(T& val) noexcept
+    {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return false;
+        }
+        T tmp = m_buffer[t & k_mask].load(std::memory_order_relaxed);
+        if (not m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        val = tmp;
+        return true;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+    constexpr std::size_t capacity() const noexcept
+    {
+        return Capacity;
+    }
+
+private:
+    static constexpr inline std::int64_t k_mask = static_cast<std::int64_t>(Capacity) - 1;
+
+    alignas(detail::k_machine_cache_line) std::atomic<std::int64_t> m_top{0};
+    alignas(detail::k_machine_cache_line) std::atomic<std::int64_t> m_bottom{0};
+    alignas(detail::k_machine_cache_line) std::array<std::atomic<T>, Capacity> m_buffer{};
+};
+
+} // namespace mlts
@@ -0,0 +1,212 @@
+#include "mlts/actor.hpp"
+#include "mlts/timer.hpp"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+template<typename F>
+static bool wait_until(F&& done, std::chrono::seconds timeout = std::chrono::seconds(30))
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (not done())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+class counter_actor : public mlts::actor<int>
+{
+public:
+    using actor::actor;
+
+    std::int64_t sum() const noexcept
+    {
+        return m_sum.load(std::memory_order_acquire);
+    }
+
+    bool overlapped() const noexcept
+    {
+        return m_overlapped;
+    }
+
+protected:
+    void receive(int& msg) override
+    {
+        // receive never runs on two workers at once, plain members are enough
+        m_overlapped = m_overlapped || m_inside.exchange(true);
+        m_local += msg;
+        m_sum.store(m_local, std::memory_order_release);
+        m_inside.store(false);
+    }
+
+private:
+    std::atomic<bool> m_inside{false};
+    bool m_overlapped{false};
+    std::int64_t m_local{0};
+    std::atomic<std::int64_t> m_sum{0};
+};
+
+TEST(actor, mul_thread_send)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::thread_pool<> tp(4, 1000);
+    counter_actor actor{tp};
+    std::vector<std::thread> senders{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        senders.emplace_back([&actor]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                actor.send(1);
+            }
+        });
+    }
+    for (auto& th : senders)
+    {
+        th.join();
+    }
+    EXPECT_TRUE(wait_until([&]() { return actor.sum() == std::int64_t{max_int} * thread_size && actor.idle(); }));
+    EXPECT_FALSE(actor.overlapped());
+    EXPECT_EQ(actor.mailbox_size(), 0);
+    tp.shutdown();
+}
+
+class recording_actor : public mlts::actor<int>
+{
+public:
+    recording_actor(mlts::thread_pool<>& tp, int id, std::vector<int>& log, std::size_t throughput)
+        : actor(tp, throughput), m_id(id), m_log(log)
+    {
+    }
+
+protected:
+    void receive(int&) override
+    {
+        m_log.push_back(m_id);
+    }
+
+private:
+    int m_id;
+    std::vector<int>& m_log;
+};
+
+TEST(actor, throughput_quota_yields_the_worker)
+{
+    // one worker, so the log needs no lock and shows the order of the turns
+    mlts::thread_pool<> tp(1, 1000);
+    std::vector<int> log{};
+    recording_actor a{tp, 0, log, 4};
+    recording_actor b{tp, 1, log, 4};
+    std::atomic<bool> release{false};
+    tp.push_func([&release]() { wait_until([&release]() { return release.load(); }); });
+    for (int i = 0; i < 12; ++i)
+    {
+        a.send(i);
+        b.send(i);
+    }
+    release = true;
+    EXPECT_TRUE(wait_until([&]() { return a.idle() && b.idle(); }));
+    tp.shutdown();
+    EXPECT_EQ(log, (std::vector<int>{0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1}));
+}
+
+class throwing_actor : public mlts::actor<int>
+{
+public:
+    using actor::actor;
+
+    std::atomic<int> m_handled{0};
+
+protected:
+    void receive(int& msg) override
+    {
+        if (msg < 0)
+        {
+            throw std::runtime_error("bad message");
+        }
+        ++m_handled;
+    }
+};
+
+TEST(actor, exception_reaches_pool_handler)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    throwing_actor actor{tp};
+    for (int i : {1, -1, 2, 3})
+    {
+        actor.send(i);
+    }
+    EXPECT_TRUE(wait_until([&]() { return actor.m_handled.load() == 3 && actor.idle(); }));
+    tp.shutdown();
+    EXPECT_EQ(tp.exception_count(), 1);
+}
+
+TEST(actor, send_after_shutdown_reports_rejection)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    counter_actor actor{tp};
+    tp.shutdown();
+    EXPECT_FALSE(actor.send(1));
+    EXPECT_TRUE(actor.idle());
+    EXPECT_EQ(actor.mailbox_size(), 1);
+
+    // the refused message is still queued, the next accepted turn handles it
+    tp.reset(1);
+    EXPECT_TRUE(actor.send(2));
+    EXPECT_TRUE(wait_until([&]() { return actor.sum() == 3 && actor.idle(); }));
+    tp.shutdown();
+}
+
+TEST(actor, many_idle_actors)
+{
+    constexpr int actor_size{100000};
+    mlts::thread_pool<> tp(4, 1000);
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::unique_ptr<counter_actor>> actors{};
+    actors.reserve(actor_size);
+    for (int i = 0; i < actor_size; ++i)
+    {
+        actors.push_back(std::make_unique<counter_actor>(tp));
+    }
+    ti.end();
+    auto create_time = ti.elapsed_time();
+
+    ti.start();
+    for (int round = 0; round < 3; ++round)
+    {
+        for (auto& a : actors)
+        {
+            a->send(1);
+        }
+    }
+    EXPECT_TRUE(wait_until([&]() {
+        for (auto& a : actors)
+        {
+            if (a->sum() != 3 || not a->idle())
+            {
+                return false;
+            }
+        }
+        return true;
+    }));
+    ti.end();
+    auto message_time = ti.elapsed_time();
+    tp.shutdown();
+
+    std::stringstream ss{};
+    ss << actor_size << " actors, sizeof " << sizeof(counter_actor) << ", created in " << create_time << ", "
+       << actor_size * 3 << " messages in " << message_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -1,6 +1,10 @@
 #include "mlts/allocator.hpp"
+#include "mlts/lock_free_queue.hpp"
 #include "mlts/timer.hpp"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <thread>
+#include <vector>
 
 TEST(mp_sc_circular_fifo_allocator, move)
 {
@@ -97,4 +101,67 @@ TEST(mp_sc_circular_fifo_allocator, mul_thread_test)
     auto* p2= alloc.allocate(1);
 
 
-}
\ No newline at end of file
+}
+TEST(mp_sc_recycle_allocator, reuse_after_batch)
+{
+    constexpr size_t batch_size = 4;
+    mlts::mp_sc_recycle_allocator<std::int64_t, batch_size> alloc{};
+    std::vector<std::int64_t*> ptrs{};
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+        ptrs.push_back(alloc.allocate(1));
+    }
+    for (auto* p : ptrs)
+    {
+        alloc.deallocate(p, 1);
+    }
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+        auto* p = alloc.allocate(1);
+        EXPECT_NE(std::find(ptrs.begin(), ptrs.end(), p), ptrs.end());
+        alloc.deallocate(p, 1);
+    }
+}
+
+TEST(mp_sc_recycle_allocator, mul_thread_producer)
+{
+    constexpr int th_size = 4;
+    constexpr int loop_size = 10000;
+    mlts::mp_sc_recycle_allocator<std::int64_t, 16> alloc{};
+    mlts::lock_free_queue<std::int64_t*> queue{};
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < th_size; ++i)
+    {
+        threads.emplace_back([&alloc, &queue]() {
+            for (int j = 0; j < loop_size; ++j)
+            {
+                auto* p = alloc.allocate(1);
+                *p = j;
+                queue.push(p);
+            }
+        });
+    }
+
+    std::int64_t res{};
+    std::int64_t right_res{};
+    for (int j = 0; j < loop_size; ++j)
+    {
+        right_res += j;
+    }
+    right_res *= th_size;
+    for (int count = 0; count < th_size * loop_size;)
+    {
+        std::int64_t* p{};
+        if (queue.pop(p))
+        {
+            res += *p;
+            alloc.deallocate(p, 1);
+            ++count;
+        }
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(res, right_res);
+}
@@ -0,0 +1,339 @@
+#include "mlts/channel.hpp"
+#include "mlts/timer.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+TEST(channel, bounded_try_send_recv_close)
+{
+    mlts::channel<int, mlts::channel_bounded<4>> ch{};
+    int v{};
+    EXPECT_EQ(ch.try_recv(v), mlts::channel_result::would_block);
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(ch.try_send(i), mlts::channel_result::ok);
+    }
+    EXPECT_EQ(ch.try_send(4), mlts::channel_result::would_block);
+    EXPECT_EQ(ch.size_approx(), 4);
+    EXPECT_EQ(*ch.recv(), 0);
+    ch.close();
+    EXPECT_TRUE(ch.closed());
+    EXPECT_EQ(ch.try_send(5), mlts::channel_result::closed);
+    EXPECT_FALSE(ch.send(5));
+    for (int i = 1; i < 4; ++i)
+    {
+        EXPECT_EQ(ch.try_recv(v), mlts::channel_result::ok);
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_EQ(ch.try_recv(v), mlts::channel_result::closed);
+    EXPECT_FALSE(ch.recv().has_value());
+}
+
+TEST(channel, bounded_dynamic_capacity_mul_thread)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::channel<int, mlts::channel_bounded<>> ch{64};
+    std::atomic<std::int64_t> res{0};
+    std::vector<std::thread> senders{};
+    std::vector<std::thread> receivers{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        senders.emplace_back([&ch, t]() {
+            for (int i = t; i < max_int; i += thread_size)
+            {
+                EXPECT_TRUE(ch.send(i));
+            }
+        });
+        receivers.emplace_back([&ch, &res]() {
+            std::int64_t sum{};
+            int v{};
+            while (ch.recv(v))
+            {
+                sum += v;
+            }
+            res += sum;
+        });
+    }
+    for (auto& th : senders)
+    {
+        th.join();
+    }
+    ch.close();
+    for (auto& th : receivers)
+    {
+        th.join();
+    }
+    EXPECT_EQ(res.load(), std::int64_t{max_int} * (max_int - 1) / 2);
+}
+
+TEST(channel, unbounded_fan_in_fan_out)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::channel<std::string, mlts::channel_unbounded> ch{};
+    std::vector<std::thread> senders{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        senders.emplace_back([&ch]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                EXPECT_EQ(ch.try_send(std::string(1, 'x')), mlts::channel_result::ok);
+            }
+        });
+    }
+    std::thread closer([&]() {
+        for (auto& th : senders)
+        {
+            th.join();
+        }
+        ch.close();
+    });
+    std::atomic<std::size_t> count{0};
+    std::vector<std::thread> receivers{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        receivers.emplace_back([&]() {
+            std::string v{};
+            while (ch.recv(v))
+            {
+                count.fetch_add(v.size(), std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& th : receivers)
+    {
+        th.join();
+    }
+    closer.join();
+    EXPECT_EQ(count.load(), std::size_t{max_int} * thread_size);
+}
+
+TEST(channel, unbuffered_send_waits_for_receiver)
+{
+    mlts::channel<int> ch{};
+    EXPECT_EQ(ch.try_send(1), mlts::channel_result::would_block);
+    int v{};
+    EXPECT_EQ(ch.try_recv(v), mlts::channel_result::would_block);
+
+    std::atomic<int> sent{0};
+    std::thread sender([&]() {
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_TRUE(ch.send(i));
+            ++sent;
+        }
+    });
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(*ch.recv(), i);
+    }
+    sender.join();
+    EXPECT_EQ(sent.load(), 3);
+}
+
+TEST(channel, unbuffered_try_send_to_parked_receiver)
+{
+    mlts::channel<std::string> ch{};
+    std::thread receiver([&]() { EXPECT_EQ(*ch.recv(), "hello"); });
+    std::string msg{"hello"};
+    while (ch.try_send(std::move(msg)) != mlts::channel_result::ok)
+    {
+        // untouched until it was handed over
+        EXPECT_EQ(msg, "hello");
+        std::this_thread::yield();
+    }
+    receiver.join();
+}
+
+TEST(channel, unbuffered_close_releases_blocked_sender)
+{
+    mlts::channel<int> ch{};
+    std::thread sender([&]() { EXPECT_FALSE(ch.send(1)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ch.close();
+    sender.join();
+    int v{};
+    EXPECT_EQ(ch.try_recv(v), mlts::channel_result::closed);
+}
+
+TEST(channel, select_is_fair)
+{
+    mlts::channel<int, mlts::channel_bounded<2048>> a{};
+    mlts::channel<int, mlts::channel_bounded<2048>> b{};
+    for (int i = 0; i < 1000; ++i)
+    {
+        a.try_send(i);
+        b.try_send(i);
+    }
+    int from_a{};
+    int from_b{};
+    for (int i = 0; i < 1000; ++i)
+    {
+        mlts::select(mlts::on_recv(a, [&](std::optional<int>) { ++from_a; }),
+                     mlts::on_recv(b, [&](std::optional<int>) { ++from_b; }));
+    }
+    EXPECT_EQ(from_a + from_b, 1000);
+    EXPECT_GT(from_a, 350);
+    EXPECT_GT(from_b, 350);
+}
+
+TEST(channel, select_waits_for_any_case)
+{
+    mlts::channel<int, mlts::channel_bounded<4>> a{};
+    mlts::channel<int, mlts::channel_unbounded> b{};
+    EXPECT_FALSE(mlts::try_select(mlts::on_recv(a, [](std::optional<int>) {}),
+                                  mlts::on_recv(b, [](std::optional<int>) {})));
+    std::thread sender([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        b.send(7);
+    });
+    int got{};
+    auto idx = mlts::select(mlts::on_recv(a, [](std::optional<int>) {}),
+                            mlts::on_recv(b, [&](std::optional<int> v) { got = *v; }));
+    sender.join();
+    EXPECT_EQ(idx, 1);
+    EXPECT_EQ(got, 7);
+
+    // a full channel blocks the send case, the closed one fires with nullopt
+    for (int i = 0; i < 4; ++i)
+    {
+        a.send(i);
+    }
+    b.close();
+    bool closed_seen{false};
+    idx = mlts::select(mlts::on_send(a, 5, [](bool) {}),
+                       mlts::on_recv(b, [&](std::optional<int> v) { closed_seen = not v; }));
+    EXPECT_EQ(idx, 1);
+    EXPECT_TRUE(closed_seen);
+}
+
+TEST(channel, select_on_both_ends_of_unbuffered)
+{
+    constexpr int max_int{1000};
+    mlts::channel<int> ch{};
+    mlts::channel<int, mlts::channel_bounded<4>> never{};
+    std::thread sender([&]() {
+        for (int i = 0; i < max_int;)
+        {
+            mlts::select(mlts::on_send(ch, i, [&i](bool sent) { i += sent; }),
+                         mlts::on_recv(never, [](std::optional<int>) {}));
+        }
+    });
+    std::int64_t res{};
+    for (int i = 0; i < max_int; ++i)
+    {
+        mlts::select(mlts::on_recv(ch, [&res](std::optional<int> v) { res += *v; }),
+                     mlts::on_recv(never, [](std::optional<int>) {}));
+    }
+    sender.join();
+    EXPECT_EQ(res, std::int64_t{max_int} * (max_int - 1) / 2);
+}
+
+// the mutex + condition variable channel the lock free ones replace
+template<typename T>
+class locked_channel
+{
+public:
+    explicit locked_channel(std::size_t capacity) : m_capacity(capacity)
+    {
+    }
+
+    void send(T value)
+    {
+        std::unique_lock lk(m_mu);
+        m_not_full.wait(lk, [this]() { return m_queue.size() < m_capacity; });
+        m_queue.push_back(std::move(value));
+        m_not_empty.notify_one();
+    }
+
+    T recv()
+    {
+        std::unique_lock lk(m_mu);
+        m_not_empty.wait(lk, [this]() { return not m_queue.empty(); });
+        T value = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        return value;
+    }
+
+private:
+    std::mutex m_mu{};
+    std::condition_variable m_not_full{};
+    std::condition_variable m_not_empty{};
+    std::deque<T> m_queue{};
+    std::size_t m_capacity;
+};
+
+TEST(channel, bounded_cmp_mutex_condvar)
+{
+    constexpr int max_int{200000};
+    constexpr int thread_size = 4;
+    mlts::timer ti{};
+
+    ti.start();
+    {
+        mlts::channel<int, mlts::channel_bounded<1024>> ch{};
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < thread_size; ++t)
+        {
+            threads.emplace_back([&ch]() {
+                for (int i = 0; i < max_int; ++i)
+                {
+                    ch.send(i);
+                }
+            });
+            threads.emplace_back([&ch]() {
+                for (int i = 0; i < max_int; ++i)
+                {
+                    ch.recv();
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto channel_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        locked_channel<int> ch{1024};
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < thread_size; ++t)
+        {
+            threads.emplace_back([&ch]() {
+                for (int i = 0; i < max_int; ++i)
+                {
+                    ch.send(i);
+                }
+            });
+            threads.emplace_back([&ch]() {
+                for (int i = 0; i < max_int; ++i)
+                {
+                    ch.recv();
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto locked_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "channel " << channel_time << " mutex+condvar " << locked_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
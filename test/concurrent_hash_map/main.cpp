@@ -0,0 +1,252 @@
+#include "mlts/concurrent_hash_map.hpp"
+#include "mlts/timer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+TEST(concurrent_hash_map, insert_find_erase)
+{
+    mlts::concurrent_hash_map<std::string, int> map{};
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.insert("a", 1));
+    EXPECT_FALSE(map.insert("a", 2));
+    EXPECT_EQ(*map.find("a"), 1);
+    EXPECT_FALSE(map.insert_or_assign("a", 3));
+    EXPECT_EQ(*map.find("a"), 3);
+    EXPECT_TRUE(map.insert_or_assign("b", 4));
+    EXPECT_FALSE(map.find("c").has_value());
+    EXPECT_EQ(map.size(), 2);
+
+    int seen{};
+    EXPECT_TRUE(map.visit("b", [&seen](const int& v) { seen = v; }));
+    EXPECT_EQ(seen, 4);
+    EXPECT_TRUE(map.erase("a"));
+    EXPECT_FALSE(map.erase("a"));
+    EXPECT_FALSE(map.contains("a"));
+    EXPECT_TRUE(map.contains("b"));
+    // the tombstone of a is reused
+    EXPECT_TRUE(map.insert("a", 5));
+    EXPECT_EQ(*map.find("a"), 5);
+    EXPECT_EQ(map.size(), 2);
+}
+
+TEST(concurrent_hash_map, grows_and_shrinks_through_migration)
+{
+    constexpr int max_int{100000};
+    mlts::concurrent_hash_map<int, int> map{};
+    auto initial = map.capacity();
+    for (int i = 0; i < max_int; ++i)
+    {
+        EXPECT_TRUE(map.insert(i, i * 2));
+    }
+    EXPECT_EQ(map.size(), max_int);
+    EXPECT_GT(map.capacity(), initial);
+    for (int i = 0; i < max_int; ++i)
+    {
+        ASSERT_EQ(*map.find(i), i * 2);
+    }
+    for (int i = 0; i < max_int; ++i)
+    {
+        EXPECT_TRUE(map.erase(i));
+    }
+    auto grown = map.capacity();
+    // churn on few live keys fills the table with tombstones, the next resize sizes it by live keys
+    for (int i = 0; i < 4 * max_int; ++i)
+    {
+        map.insert(max_int + i, i);
+        map.erase(max_int + i);
+    }
+    EXPECT_TRUE(map.empty());
+    EXPECT_LT(map.capacity(), grown);
+}
+
+TEST(concurrent_hash_map, mul_thread_insert_during_resize)
+{
+    constexpr int max_int{30000};
+    constexpr int thread_size = 8;
+    mlts::concurrent_hash_map<int, int> map{};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&map, t]() {
+            for (int i = t; i < max_int * thread_size; i += thread_size)
+            {
+                EXPECT_TRUE(map.insert(i, -i));
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(map.size(), std::size_t{max_int} * thread_size);
+    for (int i = 0; i < max_int * thread_size; ++i)
+    {
+        ASSERT_EQ(*map.find(i), -i);
+    }
+}
+
+TEST(concurrent_hash_map, readers_never_see_torn_or_freed_values)
+{
+    constexpr int key_range{4096};
+    constexpr int loop{100000};
+    struct entry
+    {
+        int m_key;
+        std::string m_text;
+    };
+    mlts::epoch_domain domain{};
+    mlts::concurrent_hash_map<int, entry> map{256, domain};
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers{};
+    for (int r = 0; r < 4; ++r)
+    {
+        readers.emplace_back([&, r]() {
+            for (int i = r; not stop.load(std::memory_order_relaxed); i = (i + 7) % key_range)
+            {
+                map.visit(i, [&bad, i](const entry& e) {
+                    if (e.m_key != i || e.m_text != std::to_string(i))
+                    {
+                        bad.fetch_add(1);
+                    }
+                });
+                mlts::quiescent_state();
+            }
+        });
+    }
+    std::vector<std::thread> writers{};
+    for (int w = 0; w < 2; ++w)
+    {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < loop; ++i)
+            {
+                int key = (i * 31 + w) % key_range;
+                if (i % 3 == 0)
+                {
+                    map.erase(key);
+                }
+                else
+                {
+                    map.insert_or_assign(key, entry{key, std::to_string(key)});
+                }
+                mlts::quiescent_state();
+            }
+        });
+    }
+    for (auto& th : writers)
+    {
+        th.join();
+    }
+    stop = true;
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    EXPECT_LE(map.size(), key_range);
+}
+
+// the read-mostly container the map replaces
+template<typename Key, typename Value>
+class shared_mutex_map
+{
+public:
+    bool contains(const Key& key) const
+    {
+        std::shared_lock lk(m_mu);
+        return m_map.find(key) != m_map.end();
+    }
+
+    void insert_or_assign(const Key& key, const Value& value)
+    {
+        std::unique_lock lk(m_mu);
+        m_map.insert_or_assign(key, value);
+    }
+
+    void erase(const Key& key)
+    {
+        std::unique_lock lk(m_mu);
+        m_map.erase(key);
+    }
+
+private:
+    mutable std::shared_mutex m_mu{};
+    std::unordered_map<Key, Value> m_map{};
+};
+
+template<typename Map>
+static std::chrono::milliseconds run_read_mostly(Map& map, int thread_size, int ops, int write_per_mille)
+{
+    constexpr int key_range{1 << 16};
+    for (int i = 0; i < key_range; i += 2)
+    {
+        map.insert_or_assign(i, i);
+    }
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&map, t, ops, write_per_mille]() {
+            std::uint64_t x = 0x9e3779b97f4a7c15ULL * static_cast<std::uint64_t>(t + 1);
+            std::size_t hits{};
+            for (int i = 0; i < ops; ++i)
+            {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                int key = static_cast<int>(x % key_range);
+                if (static_cast<int>((x >> 32) % 1000) < write_per_mille)
+                {
+                    if (key & 1)
+                    {
+                        map.erase(key);
+                    }
+                    else
+                    {
+                        map.insert_or_assign(key, key);
+                    }
+                }
+                else
+                {
+                    hits += map.contains(key);
+                }
+            }
+            EXPECT_GT(hits, 0);
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    ti.end();
+    return ti.elapsed_time();
+}
+
+TEST(concurrent_hash_map, read_mostly_cmp_shared_mutex)
+{
+    constexpr int total_ops{2000000};
+    std::stringstream ss{};
+    for (int write_per_mille : {100, 10})
+    {
+        for (int thread_size : {1, 2, 4, 8})
+        {
+            mlts::concurrent_hash_map<int, int> map{};
+            auto map_time = run_read_mostly(map, thread_size, total_ops / thread_size, write_per_mille);
+            shared_mutex_map<int, int> locked{};
+            auto locked_time = run_read_mostly(locked, thread_size, total_ops / thread_size, write_per_mille);
+            ss << (1000 - write_per_mille) / 10.0 << "/" << write_per_mille / 10.0 << " " << thread_size
+               << " threads: concurrent_hash_map " << map_time << " shared_mutex + unordered_map " << locked_time
+               << "\n";
+        }
+    }
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -0,0 +1,178 @@
+#include "mlts/flat_combining.hpp"
+#include "mlts/timer.hpp"
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+TEST(flat_combining, apply_returns_and_rethrows)
+{
+    mlts::flat_combining<std::vector<int>> fc{std::in_place, 3, 7};
+    EXPECT_EQ(fc.apply([](std::vector<int>& v) { return v.size(); }), 3);
+    fc.apply([](std::vector<int>& v) { v.push_back(8); });
+    EXPECT_EQ(fc.apply([](std::vector<int>& v) { return v.back(); }), 8);
+    EXPECT_THROW(fc.apply([](std::vector<int>& v) -> int { return v.at(100); }), std::out_of_range);
+    EXPECT_EQ(fc.unsafe_get().size(), 4);
+    auto stats = fc.stats();
+    EXPECT_EQ(stats.m_operations, 4);
+    EXPECT_EQ(stats.m_combines, 4);
+    EXPECT_EQ(stats.m_max_batch, 1);
+}
+
+TEST(flat_combining, sequence_generator_mul_thread)
+{
+    constexpr int max_int{50000};
+    constexpr int thread_size = 8;
+    mlts::flat_combining<std::int64_t> fc{};
+    std::vector<std::vector<std::int64_t>> seen(thread_size);
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&fc, &out = seen[t]]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                out.push_back(fc.apply([](std::int64_t& next) { return next++; }));
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    std::vector<std::int64_t> all{};
+    for (auto& out : seen)
+    {
+        // a thread's own operations keep their order
+        EXPECT_TRUE(std::is_sorted(out.begin(), out.end()));
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(all.size(), std::size_t{max_int} * thread_size);
+    for (std::size_t i = 0; i < all.size(); ++i)
+    {
+        EXPECT_EQ(all[i], static_cast<std::int64_t>(i));
+    }
+    auto stats = fc.stats();
+    EXPECT_EQ(stats.m_operations, std::size_t{max_int} * thread_size);
+    EXPECT_LE(stats.m_combines, stats.m_operations);
+    EXPECT_GE(stats.m_max_batch, 1);
+}
+
+TEST(flat_combining, reference_result_mul_thread)
+{
+    constexpr int max_int{20000};
+    constexpr int thread_size = 4;
+    mlts::flat_combining<std::array<std::int64_t, thread_size>> fc{};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&fc, t]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                // each thread only touches its own element through the returned reference
+                fc.apply([t](std::array<std::int64_t, thread_size>& a) -> std::int64_t& { return a[t]; }) += 1;
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    for (auto v : fc.unsafe_get())
+    {
+        EXPECT_EQ(v, max_int);
+    }
+}
+
+TEST(flat_combining, more_threads_than_slots)
+{
+    constexpr int max_int{10000};
+    constexpr int thread_size = 8;
+    mlts::flat_combining<std::map<int, int>, 2> fc{};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&fc, t]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                fc.apply([key = i * thread_size + t](std::map<int, int>& m) { m.emplace(key, key); });
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(fc.unsafe_get().size(), std::size_t{max_int} * thread_size);
+}
+
+template<typename T>
+class mutex_wrapper
+{
+public:
+    template<typename F>
+    auto apply(F&& f)
+    {
+        std::scoped_lock lk(m_mu);
+        return f(m_value);
+    }
+
+private:
+    std::mutex m_mu{};
+    T m_value{};
+};
+
+template<typename Wrapper>
+static std::chrono::milliseconds run_map_ops(Wrapper& w, int thread_size, int ops)
+{
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&w, t, ops]() {
+            for (int i = 0; i < ops; ++i)
+            {
+                int key = (i * 7919 + t) % 4096;
+                if (i & 1)
+                {
+                    w.apply([key](std::map<int, int>& m) { m.erase(key); });
+                }
+                else
+                {
+                    w.apply([key](std::map<int, int>& m) { m[key] = key; });
+                }
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    ti.end();
+    return ti.elapsed_time();
+}
+
+TEST(flat_combining, sorted_map_cmp_mutex)
+{
+    constexpr int total_ops{640000};
+    std::stringstream ss{};
+    for (int thread_size : {1, 2, 4, 8, 16, 32, 64})
+    {
+        mlts::flat_combining<std::map<int, int>> fc{};
+        auto fc_time = run_map_ops(fc, thread_size, total_ops / thread_size);
+        mutex_wrapper<std::map<int, int>> locked{};
+        auto locked_time = run_map_ops(locked, thread_size, total_ops / thread_size);
+        auto stats = fc.stats();
+        ss << thread_size << " threads: flat_combining " << fc_time << " (avg batch "
+           << static_cast<double>(stats.m_operations) / static_cast<double>(std::max<std::size_t>(stats.m_combines, 1))
+           << ", max " << stats.m_max_batch << ") mutex " << locked_time << "\n";
+    }
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -0,0 +1,129 @@
+#include "mlts/fork_join.hpp"
+#include "mlts/thread_pool.hpp"
+#include "mlts/timer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <set>
+#include <vector>
+
+
+template<typename Pool>
+std::int64_t fib(Pool& pool, std::int64_t n)
+{
+    if (n < 2)
+    {
+        return n;
+    }
+    std::int64_t x{};
+    std::int64_t y{};
+    mlts::fork_join(pool, [&]() { x = fib(pool, n - 1); }, [&]() { y = fib(pool, n - 2); });
+    return x + y;
+}
+
+template<typename Pool>
+std::int64_t range_sum(Pool& pool, const std::int64_t* begin, const std::int64_t* end)
+{
+    auto len = end - begin;
+    if (len <= 64)
+    {
+        return std::accumulate(begin, end, std::int64_t{});
+    }
+    auto quarter = len / 4;
+    std::int64_t res[4]{};
+    auto f0 = [&]() { res[0] = range_sum(pool, begin, begin + quarter); };
+    auto f1 = [&]() { res[1] = range_sum(pool, begin + quarter, begin + quarter * 2); };
+    auto f2 = [&]() { res[2] = range_sum(pool, begin + quarter * 2, begin + quarter * 3); };
+    mlts::fork_scope<Pool> scope(pool);
+    scope.spawn(f0);
+    scope.spawn(f1);
+    scope.spawn(f2);
+    res[3] = range_sum(pool, begin + quarter * 3, end);
+    scope.sync();
+    return res[0] + res[1] + res[2] + res[3];
+}
+
+TEST(fork_join, fib_outside_pool)
+{
+    mlts::thread_pool<> tp(4, 1000);
+    EXPECT_EQ(fib(tp, 20), 6765);
+}
+
+TEST(fork_join, fib_inside_pool)
+{
+    mlts::thread_pool<> tp(4, 1000);
+    auto res = tp.submit([&tp]() { return fib(tp, 22); });
+    EXPECT_EQ(res.get(), 17711);
+}
+
+TEST(fork_join, spawn_sync_range_sum)
+{
+    mlts::thread_pool<> tp(4, 1000);
+    std::vector<std::int64_t> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    auto right_res = std::accumulate(values.begin(), values.end(), std::int64_t{});
+    auto res = tp.submit([&]() { return range_sum(tp, values.data(), values.data() + values.size()); });
+    EXPECT_EQ(res.get(), right_res);
+}
+
+TEST(fork_join, spawn_after_shutdown_runs_inline)
+{
+    mlts::thread_pool<> tp(2, 1000);
+    tp.shutdown();
+    // the pool rejects the children, they run on the calling thread instead of never
+    EXPECT_EQ(fib(tp, 15), 610);
+    int ran{};
+    auto f = [&ran]() { ++ran; };
+    mlts::fork_scope<mlts::thread_pool<>> scope(tp);
+    scope.spawn(f);
+    scope.spawn(f);
+    scope.sync();
+    EXPECT_EQ(ran, 2);
+}
+
+TEST(fork_join, child_exception)
+{
+    mlts::thread_pool<> tp(2, 1000);
+    auto res = tp.submit([&tp]() {
+        int x{};
+        mlts::fork_join(tp, [&x]() { x = 1; }, []() { throw std::runtime_error("child failed"); });
+        return x;
+    });
+    EXPECT_THROW(res.get(), std::runtime_error);
+    EXPECT_EQ(tp.exception_count(), 0);
+}
+
+TEST(fork_join, children_are_stolen)
+{
+    mlts::thread_pool<> tp(4, 1000);
+    std::mutex mu{};
+    std::set<std::thread::id> ids{};
+    auto record = [&]() {
+        std::scoped_lock lk(mu);
+        ids.insert(std::this_thread::get_id());
+    };
+    std::atomic<bool> is_release{false};
+    auto res = tp.submit([&]() {
+        auto slow = [&]() {
+            record();
+            while (not is_release.load())
+            {
+                std::this_thread::yield();
+            }
+        };
+        auto fast = [&]() { record(); };
+        mlts::fork_scope<mlts::thread_pool<>> scope(tp);
+        scope.spawn(fast);
+        scope.spawn(fast);
+        scope.spawn(fast);
+        std::thread releaser([&is_release]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            is_release.store(true);
+        });
+        slow();
+        scope.sync();
+        releaser.join();
+    });
+    res.get();
+    EXPECT_GT(ids.size(), 1);
+}
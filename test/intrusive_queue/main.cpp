@@ -0,0 +1,220 @@
+#include "mlts/intrusive_queue.hpp"
+#include "mlts/lock_free_queue.hpp"
+#include "mlts/timer.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+struct test_event
+{
+    int m_value{};
+    mlts::intrusive_queue_hook m_hook{};
+    std::int64_t m_payload[4]{};
+};
+
+using mpsc_queue_type = mlts::intrusive_mpsc_queue<test_event, &test_event::m_hook>;
+using spsc_queue_type = mlts::intrusive_spsc_queue<test_event, &test_event::m_hook>;
+
+template<typename Queue>
+void check_order()
+{
+    Queue queue{};
+    std::vector<test_event> events(10);
+    EXPECT_EQ(queue.pop(), nullptr);
+    EXPECT_TRUE(queue.empty());
+    for (int i = 0; i < 10; ++i)
+    {
+        events[i].m_value = i;
+        queue.push(events[i]);
+    }
+    EXPECT_FALSE(queue.empty());
+    for (int i = 0; i < 10; ++i)
+    {
+        test_event* e = queue.pop();
+        ASSERT_EQ(e, &events[i]);
+        EXPECT_EQ(e->m_value, i);
+    }
+    EXPECT_EQ(queue.pop(), nullptr);
+    EXPECT_TRUE(queue.empty());
+
+    // popped elements can be pushed again right away, also the last one
+    queue.push(events[9]);
+    EXPECT_EQ(queue.pop(), &events[9]);
+    queue.push(events[9]);
+    queue.push(events[3]);
+    EXPECT_EQ(queue.pop(), &events[9]);
+    EXPECT_EQ(queue.pop(), &events[3]);
+    EXPECT_EQ(queue.pop(), nullptr);
+}
+
+TEST(intrusive_queue, mpsc_order)
+{
+    check_order<mpsc_queue_type>();
+}
+
+TEST(intrusive_queue, spsc_order)
+{
+    check_order<spsc_queue_type>();
+}
+
+TEST(intrusive_queue, hook_copy)
+{
+    test_event a{};
+    a.m_value = 1;
+    mpsc_queue_type queue{};
+    queue.push(a);
+    test_event b = a;
+    EXPECT_EQ(b.m_value, 1);
+    EXPECT_EQ(b.m_hook.m_next.load(), nullptr);
+    EXPECT_EQ(queue.pop(), &a);
+}
+
+TEST(intrusive_queue, mul_producer_single_consumer)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 8;
+    std::vector<std::unique_ptr<test_event[]>> pools{};
+    for (int i = 0; i < thread_size; ++i)
+    {
+        pools.emplace_back(std::make_unique<test_event[]>(max_int));
+    }
+    mpsc_queue_type queue{};
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < thread_size; ++i)
+    {
+        threads.emplace_back([&queue, pool = pools[i].get()]() {
+            for (int j = 0; j < max_int; ++j)
+            {
+                pool[j].m_value = j;
+                queue.push(pool[j]);
+            }
+        });
+    }
+    std::int64_t res{};
+    for (std::int64_t count = 0; count < std::int64_t{max_int} * thread_size;)
+    {
+        test_event* e = queue.pop();
+        if (e == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        res += e->m_value;
+        ++count;
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(queue.pop(), nullptr);
+    EXPECT_EQ(res, std::int64_t{max_int} * (max_int - 1) / 2 * thread_size);
+}
+
+TEST(intrusive_queue, single_producer_single_consumer_recycle)
+{
+    // the consumer hands events back to the producer through a second queue
+    constexpr int max_int{200000};
+    constexpr int pool_size{64};
+    std::vector<test_event> pool(pool_size);
+    spsc_queue_type queue{};
+    spsc_queue_type free_queue{};
+    for (auto& e : pool)
+    {
+        free_queue.push(e);
+    }
+    std::thread producer([&]() {
+        for (int j = 0; j < max_int;)
+        {
+            test_event* e = free_queue.pop();
+            if (e == nullptr)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            e->m_value = j++;
+            queue.push(*e);
+        }
+    });
+    std::int64_t res{};
+    bool in_order{true};
+    for (int expect = 0; expect < max_int;)
+    {
+        test_event* e = queue.pop();
+        if (e == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        in_order = in_order && e->m_value == expect;
+        ++expect;
+        res += e->m_value;
+        free_queue.push(*e);
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(res, std::int64_t{max_int} * (max_int - 1) / 2);
+}
+
+TEST(intrusive_queue, mpsc_cmp_lock_free_queue)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 8;
+    auto pool = std::make_unique<test_event[]>(std::size_t{max_int} * thread_size);
+    mlts::timer ti{};
+
+    ti.start();
+    {
+        mpsc_queue_type queue{};
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&queue, events = pool.get() + std::size_t{max_int} * i]() {
+                for (int j = 0; j < max_int; ++j)
+                {
+                    queue.push(events[j]);
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+        while (queue.pop())
+        {
+        }
+    }
+    ti.end();
+    auto intrusive_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        mlts::lock_free_queue<test_event> queue{};
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&queue, events = pool.get() + std::size_t{max_int} * i]() {
+                for (int j = 0; j < max_int; ++j)
+                {
+                    queue.push(events[j]);
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+        test_event e{};
+        while (queue.pop(e))
+        {
+        }
+    }
+    ti.end();
+    auto queue_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "intrusive " << intrusive_time << " lock_free_queue " << queue_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -3,6 +3,10 @@
 #include "mlts/lock_free_queue.hpp"
 #include "mlts/timer.hpp"
 #include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <thread>
 
@@ -37,7 +41,7 @@ TEST(lock_free_circular_queue, pop_front)
                 for (int j = 0; j < pop_loop_size;)
                 {
                     int tmp{};
-                    if (queue.pop(tmp))
+                    if (queue.try_pop(tmp))
                     {
                         res.fetch_add(tmp);
                         ++j;
@@ -57,3 +61,235 @@ TEST(lock_free_circular_queue, pop_front)
     }
     EXPECT_EQ(res, real_res);
 }
+
+TEST(lock_free_circular_queue, full_and_empty)
+{
+    mlts::lock_free_circular_queue<int, 4> queue{};
+    int tmp{};
+    EXPECT_EQ(queue.try_pop(tmp), false);
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(queue.try_push(i), true);
+    }
+    EXPECT_EQ(queue.try_push(4), false);
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(queue.try_pop(tmp), true);
+        EXPECT_EQ(tmp, i);
+    }
+    EXPECT_EQ(queue.try_pop(tmp), false);
+    EXPECT_EQ(queue.try_push(5), true);
+    queue.pop(tmp);
+    EXPECT_EQ(tmp, 5);
+}
+
+TEST(lock_free_circular_queue, destroy_left_values)
+{
+    auto val = std::make_shared<std::string>("left");
+    {
+        mlts::lock_free_circular_queue<std::shared_ptr<std::string>, 8> queue{};
+        queue.push(val);
+        queue.push(val);
+        std::shared_ptr<std::string> tmp{};
+        queue.pop(tmp);
+        EXPECT_EQ(val.use_count(), 3);
+    }
+    EXPECT_EQ(val.use_count(), 1);
+}
+
+static bool s_assign_throws{false};
+
+struct throwing_assign
+{
+    throwing_assign() = default;
+
+    explicit throwing_assign(int value) : m_value(value)
+    {
+    }
+
+    throwing_assign(throwing_assign&&) = default;
+
+    throwing_assign& operator=(throwing_assign&& other)
+    {
+        if (s_assign_throws)
+        {
+            throw std::runtime_error("assign");
+        }
+        m_value = other.m_value;
+        return *this;
+    }
+
+    int m_value{};
+};
+
+TEST(lock_free_circular_queue, throwing_assign_releases_cell)
+{
+    mlts::lock_free_circular_queue<throwing_assign, 2> queue{};
+    EXPECT_TRUE(queue.try_emplace(1));
+    EXPECT_TRUE(queue.try_emplace(2));
+    throwing_assign tmp{};
+    s_assign_throws = true;
+    EXPECT_THROW(queue.try_pop(tmp), std::runtime_error);
+    s_assign_throws = false;
+    EXPECT_TRUE(queue.try_pop(tmp));
+    EXPECT_EQ(tmp.m_value, 2);
+    // both cells are free again, a wedged one would keep try_emplace failing
+    EXPECT_TRUE(queue.try_emplace(3));
+    EXPECT_TRUE(queue.try_emplace(4));
+    EXPECT_TRUE(queue.try_pop(tmp));
+    EXPECT_EQ(tmp.m_value, 3);
+}
+
+TEST(lock_free_circular_queue, mul_producer_mul_consumer)
+{
+    mlts::lock_free_circular_queue<std::int64_t, 256> queue{};
+    std::atomic<std::int64_t> res{};
+    std::int64_t real_res{};
+    constexpr int push_th_size = 4;
+    constexpr int pop_th_size = 4;
+    constexpr int push_loop_size = 100000;
+    constexpr int pop_loop_size = push_loop_size * push_th_size / pop_th_size;
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < push_th_size; ++i)
+        {
+            threads.emplace_back([&queue]() {
+                for (int j = 0; j < push_loop_size; ++j)
+                {
+                    queue.push(j);
+                }
+            });
+        }
+        for (int i = 0; i < pop_th_size; ++i)
+        {
+            threads.emplace_back([&queue, &res]() {
+                std::int64_t local{};
+                for (int j = 0; j < pop_loop_size; ++j)
+                {
+                    std::int64_t tmp{};
+                    queue.pop(tmp);
+                    local += tmp;
+                }
+                res.fetch_add(local);
+            });
+        }
+    }
+    for (int j = 0; j < push_loop_size; ++j)
+    {
+        real_res += j;
+    }
+    real_res *= push_th_size;
+    EXPECT_EQ(res.load(), real_res);
+    std::int64_t tmp{};
+    EXPECT_EQ(queue.try_pop(tmp), false);
+}
+
+TEST(lock_free_circular_queue, dynamic_capacity)
+{
+    mlts::lock_free_circular_queue<int, mlts::DynamicSize32> queue(100);
+    EXPECT_EQ(queue.capacity(), 128);
+    EXPECT_EQ(queue.m_buffer.mask(), 127);
+    for (int i = 0; i < 128; ++i)
+    {
+        EXPECT_EQ(queue.try_push(i), true);
+    }
+    EXPECT_EQ(queue.try_push(128), false);
+    int tmp{};
+    for (int i = 0; i < 128; ++i)
+    {
+        queue.pop(tmp);
+        EXPECT_EQ(tmp, i);
+    }
+    EXPECT_EQ(queue.try_pop(tmp), false);
+    // rounding up would overflow the 32 bit capacity
+    using queue_type = mlts::lock_free_circular_queue<int, mlts::DynamicSize32>;
+    EXPECT_THROW(queue_type((std::uint32_t{1} << 31) + 1), std::length_error);
+}
+
+TEST(lock_free_circular_queue, dynamic_capacity_huge_page)
+{
+    constexpr std::uint32_t capacity = 1 << 20;
+    mlts::lock_free_circular_queue<std::int64_t, mlts::DynamicSize32> queue(capacity);
+    EXPECT_EQ(queue.capacity(), capacity);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&queue.m_buffer[0]) % mlts::detail::k_huge_page_size, 0);
+    std::atomic<std::int64_t> res{};
+    std::int64_t real_res{};
+    constexpr int th_size = 2;
+    constexpr int loop_size = 100000;
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < th_size; ++i)
+        {
+            threads.emplace_back([&queue]() {
+                for (int j = 0; j < loop_size; ++j)
+                {
+                    queue.push(j);
+                }
+            });
+            threads.emplace_back([&queue, &res]() {
+                std::int64_t local{};
+                for (int j = 0; j < loop_size; ++j)
+                {
+                    std::int64_t tmp{};
+                    queue.pop(tmp);
+                    local += tmp;
+                }
+                res.fetch_add(local);
+            });
+        }
+    }
+    for (int j = 0; j < loop_size; ++j)
+    {
+        real_res += j;
+    }
+    EXPECT_EQ(res.load(), real_res * th_size);
+}
+
+TEST(lock_free_circular_queue, static_and_dynamic_cmp)
+{
+    constexpr int loop_size = 1000000;
+    mlts::lock_free_circular_queue<int, 1024> static_queue{};
+    mlts::lock_free_circular_queue<int, mlts::DynamicSize32> dynamic_queue(1024);
+    mlts::timer ti{};
+    int tmp{};
+    ti.start();
+    for (int i = 0; i < loop_size; ++i)
+    {
+        static_queue.try_push(i);
+        static_queue.try_pop(tmp);
+    }
+    ti.end();
+    auto static_time = ti.elapsed_time<std::chrono::microseconds>();
+    ti.start();
+    for (int i = 0; i < loop_size; ++i)
+    {
+        dynamic_queue.try_push(i);
+        dynamic_queue.try_pop(tmp);
+    }
+    ti.end();
+    auto dynamic_time = ti.elapsed_time<std::chrono::microseconds>();
+    std::stringstream ss{};
+    ss << "static " << static_time << " dynamic " << dynamic_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_EQ(tmp, loop_size - 1);
+}
+
+TEST(lock_free_circular_queue, size_approx_and_stats)
+{
+    mlts::lock_free_circular_queue<int, 8> queue{};
+    EXPECT_TRUE(queue.empty());
+    for (int i = 0; i < 8; ++i)
+    {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.size_approx(), 8);
+    int val{};
+    queue.try_pop(val);
+    queue.try_pop(val);
+    EXPECT_EQ(queue.size_approx(), 6);
+    EXPECT_FALSE(queue.empty());
+    auto stats = queue.stats();
+    EXPECT_EQ(stats.m_enqueued, 8);
+    EXPECT_EQ(stats.m_dequeued, 2);
+    EXPECT_EQ(stats.m_high_water, mlts::detail::queue_high_water::enabled() ? 8 : 0);
+}
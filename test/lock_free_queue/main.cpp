@@ -5,10 +5,15 @@
 #include <fstream>
 #include <functional>
 #include <gtest/gtest.h>
+#include <chrono>
+#include <ctime>
 #include <map>
+#include <memory>
+#include <optional>
 #include <mutex>
 #include <queue>
 #include <vector>
+#include <string>
 
 
 using fq_node_type = mlts::lock_free_queue_node<int>;
@@ -707,4 +712,543 @@ TEST(lock_free_queue, single_thread_pop_front_func_cmp_res_with_mp_sc_circular_f
     right_res *= thread_size;
 
     EXPECT_EQ(free_res, right_res);
-}
\ No newline at end of file
+}
+TEST(lock_free_queue, pop_bulk)
+{
+    mlts::lock_free_queue<int> queue{};
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(i);
+    }
+    std::vector<int> out{};
+    EXPECT_EQ(queue.pop_bulk(std::back_inserter(out), 4), 4);
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3}));
+    EXPECT_EQ(queue.pop_bulk(std::back_inserter(out), 100), 6);
+    EXPECT_EQ(out.size(), 10);
+    EXPECT_EQ(out.back(), 9);
+    EXPECT_EQ(queue.pop_bulk(std::back_inserter(out), 100), 0);
+
+    queue.push(10);
+    int val{};
+    EXPECT_EQ(queue.pop(val), true);
+    EXPECT_EQ(val, 10);
+}
+
+TEST(lock_free_queue, consume_all_free_nodes)
+{
+    std::map<fq_node_type*, int> ptr_map{};
+    test_allocator::s_callback = [&ptr_map](const std::map<fq_node_type*, int>& m) { ptr_map = m; };
+    {
+        mlts::lock_free_queue<int, test_allocator> queue;
+        for (int i = 0; i < 5; ++i)
+        {
+            queue.push(i);
+        }
+        int sum{};
+        EXPECT_EQ(queue.consume_all([&sum](int val) { sum += val; }), 5);
+        EXPECT_EQ(sum, 10);
+        EXPECT_EQ(queue.consume_all([&sum](int val) { sum += val; }), 0);
+    }
+    for (const auto& [k, v] : ptr_map)
+    {
+        EXPECT_EQ(v, 0);
+    }
+}
+
+// takes chains, counts the calls
+template<typename T>
+struct chain_allocator
+{
+    using value_type = T;
+
+    T* allocate(size_t n)
+    {
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        ++s_single;
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    template<typename Next>
+    void deallocate_chain(T* first, size_t count, Next&& next)
+    {
+        ++s_chain;
+        for (size_t i = 0; i < count; ++i)
+        {
+            T* following = next(first);
+            std::allocator<T>{}.deallocate(first, 1);
+            first = following;
+        }
+    }
+
+    static inline size_t s_single{0};
+    static inline size_t s_chain{0};
+};
+
+TEST(lock_free_queue, consume_all_frees_chain_and_values)
+{
+    auto val = std::make_shared<int>(4);
+    using node_type = mlts::lock_free_queue_node<std::shared_ptr<int>>;
+    mlts::lock_free_queue<std::shared_ptr<int>, chain_allocator<node_type>> queue{};
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(val);
+    }
+    EXPECT_EQ(val.use_count(), 11);
+    int sum{};
+    EXPECT_EQ(queue.consume_all([&sum](const std::shared_ptr<int>& v) { sum += *v; }), 10);
+    EXPECT_EQ(sum, 40);
+    // the last value consumed is not kept alive by the stub
+    EXPECT_EQ(val.use_count(), 1);
+    EXPECT_EQ(chain_allocator<node_type>::s_chain, 1);
+    EXPECT_EQ(chain_allocator<node_type>::s_single, 0);
+
+    std::vector<std::shared_ptr<int>> out{};
+    queue.push(val);
+    queue.push(val);
+    EXPECT_EQ(queue.pop_bulk(std::back_inserter(out), 8), 2);
+    out.clear();
+    EXPECT_EQ(val.use_count(), 1);
+}
+
+TEST(lock_free_queue, consume_all_throw)
+{
+    mlts::lock_free_queue<int> queue{};
+    for (int i = 0; i < 5; ++i)
+    {
+        queue.push(i);
+    }
+    std::vector<int> seen{};
+    EXPECT_THROW(queue.consume_all([&seen](int val) {
+        if (val == 2)
+        {
+            throw std::runtime_error("stop");
+        }
+        seen.push_back(val);
+    }),
+                 std::runtime_error);
+    EXPECT_EQ(seen, (std::vector<int>{0, 1}));
+    queue.consume_all([&seen](int val) { seen.push_back(val); });
+    EXPECT_EQ(seen, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST(lock_free_queue, mul_thread_push_consume_all_cmp_pop)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 8;
+    constexpr std::int64_t all_size = std::int64_t{max_int} * thread_size;
+    std::int64_t right_res = std::int64_t{max_int} * (max_int - 1) / 2 * thread_size;
+    using test_queue_type =
+        mlts::lock_free_queue<int, mlts::mp_sc_recycle_allocator<mlts::lock_free_queue_node<int>>>;
+
+    auto run = [&](auto&& drain) {
+        test_queue_type queue{};
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&queue]() {
+                for (int j = 0; j < max_int; ++j)
+                {
+                    queue.push(j);
+                }
+            });
+        }
+        std::int64_t res{};
+        for (std::int64_t count = 0; count < all_size;)
+        {
+            count += drain(queue, res);
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+        return res;
+    };
+
+    mlts::timer ti{};
+    ti.start();
+    auto pop_res = run([](test_queue_type& queue, std::int64_t& res) {
+        int val{};
+        std::int64_t count{};
+        while (queue.pop(val))
+        {
+            res += val;
+            ++count;
+        }
+        return count;
+    });
+    ti.end();
+    auto pop_time = ti.elapsed_time();
+
+    ti.start();
+    auto consume_res = run([](test_queue_type& queue, std::int64_t& res) {
+        return static_cast<std::int64_t>(queue.consume_all([&res](int val) { res += val; }));
+    });
+    ti.end();
+    auto consume_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "pop " << pop_time << " consume_all " << consume_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_EQ(pop_res, right_res);
+    EXPECT_EQ(consume_res, right_res);
+}
+
+struct move_count_message
+{
+    move_count_message() = default;
+    move_count_message(int id, std::string name) : m_id(id), m_name(std::move(name))
+    {
+    }
+    move_count_message(const move_count_message& other) : m_id(other.m_id), m_name(other.m_name)
+    {
+        ++s_copy;
+    }
+    move_count_message(move_count_message&& other) noexcept : m_id(other.m_id), m_name(std::move(other.m_name))
+    {
+        ++s_move;
+    }
+    move_count_message& operator=(const move_count_message& other)
+    {
+        m_id = other.m_id;
+        m_name = other.m_name;
+        ++s_copy;
+        return *this;
+    }
+    move_count_message& operator=(move_count_message&& other) noexcept
+    {
+        m_id = other.m_id;
+        m_name = std::move(other.m_name);
+        ++s_move;
+        return *this;
+    }
+
+    int m_id{};
+    std::string m_name{};
+    char m_payload[160]{};
+    static inline int s_copy{0};
+    static inline int s_move{0};
+};
+
+TEST(lock_free_queue, emplace_and_optional_pop)
+{
+    mlts::lock_free_queue<move_count_message> queue{};
+    move_count_message::s_copy = 0;
+    move_count_message::s_move = 0;
+    queue.emplace(1, "first");
+    queue.emplace(2, "second");
+    EXPECT_EQ(move_count_message::s_copy, 0);
+    EXPECT_EQ(move_count_message::s_move, 0);
+
+    std::optional<move_count_message> val = queue.pop();
+    ASSERT_TRUE(val.has_value());
+    EXPECT_EQ(val->m_id, 1);
+    EXPECT_EQ(val->m_name, "first");
+    EXPECT_EQ(move_count_message::s_move, 1);
+
+    int id{};
+    EXPECT_TRUE(queue.pop([&id](move_count_message& msg) { id = msg.m_id; }));
+    EXPECT_EQ(id, 2);
+    EXPECT_EQ(move_count_message::s_copy, 0);
+    EXPECT_EQ(move_count_message::s_move, 1);
+
+    EXPECT_FALSE(queue.pop().has_value());
+    EXPECT_FALSE(queue.pop([](move_count_message&) {}));
+}
+
+TEST(lock_free_queue, emplace_prefers_constructor_over_initializer_list)
+{
+    mlts::lock_free_queue<std::vector<int>> queue{};
+    queue.emplace(3, 7);
+    queue.emplace(3u, 7);
+    auto val = queue.pop();
+    ASSERT_TRUE(val.has_value());
+    EXPECT_EQ(*val, (std::vector<int>{7, 7, 7}));
+    val = queue.pop();
+    ASSERT_TRUE(val.has_value());
+    EXPECT_EQ(*val, (std::vector<int>{7, 7, 7}));
+}
+
+TEST(lock_free_queue, visitor_pop_throw)
+{
+    mlts::lock_free_queue<int> queue{};
+    queue.push(1);
+    EXPECT_THROW(queue.pop([](int&) { throw std::runtime_error("stop"); }), std::runtime_error);
+    int val{};
+    EXPECT_TRUE(queue.pop(val));
+    EXPECT_EQ(val, 1);
+}
+
+TEST(lock_free_queue, emplace_cmp_push)
+{
+    constexpr int max_int{200000};
+    mlts::lock_free_queue<move_count_message, mlts::mp_sc_recycle_allocator<mlts::lock_free_queue_node<move_count_message>>>
+        queue{};
+    mlts::timer ti{};
+    std::int64_t push_res{};
+    ti.start();
+    for (int i = 0; i < max_int; ++i)
+    {
+        queue.push(move_count_message{i, "message"});
+        move_count_message val{};
+        queue.pop(val);
+        push_res += val.m_id;
+    }
+    ti.end();
+    auto push_time = ti.elapsed_time<std::chrono::microseconds>();
+
+    std::int64_t emplace_res{};
+    ti.start();
+    for (int i = 0; i < max_int; ++i)
+    {
+        queue.emplace(i, "message");
+        queue.pop([&emplace_res](move_count_message& msg) { emplace_res += msg.m_id; });
+    }
+    ti.end();
+    auto emplace_time = ti.elapsed_time<std::chrono::microseconds>();
+
+    std::stringstream ss{};
+    ss << "push + pop " << push_time << " emplace + visitor pop " << emplace_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_EQ(push_res, emplace_res);
+}
+
+template<typename Queue>
+concept waitable_queue = requires(Queue& queue, typename Queue::value_type& val) { queue.wait_pop(val); };
+
+TEST(lock_free_queue, wait_pop_opt_in)
+{
+    EXPECT_FALSE(waitable_queue<mlts::lock_free_queue<int>>);
+    EXPECT_TRUE(waitable_queue<mlts::blocking_lock_free_queue<int>>);
+    // the plain queue carries no event count
+    EXPECT_LT(sizeof(mlts::lock_free_queue<int>), sizeof(mlts::blocking_lock_free_queue<int>));
+}
+
+TEST(lock_free_queue, wait_pop)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::blocking_lock_free_queue<int> queue{};
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < thread_size; ++i)
+    {
+        threads.emplace_back([&queue]() {
+            for (int j = 0; j < max_int; ++j)
+            {
+                queue.push(j);
+                if (j % 1000 == 0)
+                {
+                    // let the consumer run dry and park now and then
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        });
+    }
+    std::int64_t res{};
+    for (int i = 0; i < max_int * thread_size; ++i)
+    {
+        int val{};
+        queue.wait_pop(val);
+        res += val;
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(res, std::int64_t{max_int} * (max_int - 1) / 2 * thread_size);
+}
+
+TEST(lock_free_queue, wait_pop_for)
+{
+    mlts::blocking_lock_free_queue<int> queue{};
+    int val{};
+    mlts::timer ti{};
+    ti.start();
+    EXPECT_FALSE(queue.wait_pop_for(val, std::chrono::milliseconds(20)));
+    ti.end();
+    EXPECT_GE(ti.elapsed_time().count(), 19);
+
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.push(7);
+    });
+    EXPECT_TRUE(queue.wait_pop_for(val, std::chrono::seconds(10)));
+    EXPECT_EQ(val, 7);
+    producer.join();
+}
+
+TEST(lock_free_queue, wait_pop_parks)
+{
+    mlts::blocking_lock_free_queue<int> queue{};
+    std::clock_t cpu_start = std::clock();
+    std::thread consumer([&queue]() {
+        int val{};
+        queue.wait_pop(val);
+        EXPECT_EQ(val, 1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    queue.push(1);
+    consumer.join();
+    auto cpu_ms = (std::clock() - cpu_start) * 1000 / CLOCKS_PER_SEC;
+    std::stringstream ss{};
+    ss << "idle consumer cpu " << cpu_ms << "ms in 200ms\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_LT(cpu_ms, 100);
+}
+
+TEST(lock_free_queue, size_approx_and_stats)
+{
+    mlts::lock_free_queue<int> queue{};
+    EXPECT_TRUE(queue.empty());
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(i);
+    }
+    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(queue.size_approx(), 10);
+    int val{};
+    queue.pop(val);
+    queue.pop();
+    queue.pop([](int&) {});
+    std::vector<int> out{};
+    queue.pop_bulk(std::back_inserter(out), 3);
+    EXPECT_EQ(queue.size_approx(), 4);
+    queue.consume_all([](int) {});
+    EXPECT_TRUE(queue.empty());
+    auto stats = queue.stats();
+    EXPECT_EQ(stats.m_enqueued, 10);
+    EXPECT_EQ(stats.m_dequeued, 10);
+    EXPECT_EQ(stats.m_high_water, mlts::detail::queue_high_water::enabled() ? 10 : 0);
+}
+
+TEST(lock_free_queue, batch_producer_flush_rules)
+{
+    mlts::lock_free_queue<int> queue{};
+    {
+        mlts::lock_free_queue<int>::batch_producer producer{queue, 4};
+        for (int i = 0; i < 3; ++i)
+        {
+            producer.push(i);
+        }
+        EXPECT_EQ(producer.staged(), 3);
+        EXPECT_TRUE(queue.empty());
+        producer.emplace(3);
+        EXPECT_EQ(producer.staged(), 0);
+        EXPECT_EQ(queue.size_approx(), 4);
+        producer.push(4);
+        producer.flush();
+        EXPECT_EQ(queue.size_approx(), 5);
+        // staged values are published when the producer goes away
+        producer.push(5);
+    }
+    std::vector<int> out{};
+    queue.pop_bulk(std::back_inserter(out), 10);
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3, 4, 5}));
+
+    mlts::lock_free_queue<int>::batch_producer producer{queue, 1000, std::chrono::milliseconds(10)};
+    producer.push(1);
+    EXPECT_FALSE(producer.flush_due());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(producer.flush_due());
+    EXPECT_EQ(queue.size_approx(), 1);
+    producer.push(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // the next emplace sees the oldest value is overdue and publishes both
+    producer.push(3);
+    EXPECT_EQ(queue.size_approx(), 3);
+    EXPECT_EQ(queue.stats().m_enqueued, 9);
+}
+
+TEST(lock_free_queue, batch_producer_mul_thread_keeps_order)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::lock_free_queue<std::pair<int, int>> queue{};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&queue, t]() {
+            mlts::lock_free_queue<std::pair<int, int>>::batch_producer producer{queue, static_cast<std::size_t>(t + 1) * 7};
+            for (int i = 0; i < max_int; ++i)
+            {
+                producer.emplace(t, i);
+            }
+        });
+    }
+    std::vector<int> next(thread_size, 0);
+    int received{};
+    while (received < max_int * thread_size)
+    {
+        received += static_cast<int>(queue.consume_all([&next](std::pair<int, int>& v) {
+            EXPECT_EQ(v.second, next[v.first]);
+            ++next[v.first];
+        }));
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(next, std::vector<int>(thread_size, max_int));
+    EXPECT_TRUE(queue.empty());
+}
+
+template<typename Push>
+static std::chrono::milliseconds run_many_producers(mlts::lock_free_queue<int>& queue, int thread_size, int max_int,
+                                                    Push&& push)
+{
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&push, max_int]() { push(max_int); });
+    }
+    std::int64_t received{};
+    while (received < std::int64_t{max_int} * thread_size)
+    {
+        auto count = queue.consume_all([](int) {});
+        if (count == 0)
+        {
+            std::this_thread::yield();
+        }
+        received += count;
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    ti.end();
+    return ti.elapsed_time();
+}
+
+TEST(lock_free_queue, batch_producer_cmp_push)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 16;
+    std::stringstream ss{};
+    mlts::lock_free_queue<int> queue{};
+    auto push_time = run_many_producers(queue, thread_size, max_int, [&queue](int count) {
+        for (int i = 0; i < count; ++i)
+        {
+            queue.push(i);
+        }
+    });
+    ss << thread_size << " producers: push " << push_time;
+    for (std::size_t batch_size : {8, 32, 128})
+    {
+        auto batch_time = run_many_producers(queue, thread_size, max_int, [&queue, batch_size](int count) {
+            mlts::lock_free_queue<int>::batch_producer producer{queue, batch_size};
+            for (int i = 0; i < count; ++i)
+            {
+                producer.push(i);
+            }
+        });
+        ss << ", batch " << batch_size << " " << batch_time;
+    }
+    ss << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,309 @@
+#include "mlts/function.hpp"
+#include "mlts/lock_free_segment_queue.hpp"
+#include "mlts/thread_pool.hpp"
+#include "mlts/timer.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+TEST(lock_free_segment_queue, pop_front)
+{
+    mlts::lock_free_segment_queue<int, 4> queue{};
+    int tmp{};
+    EXPECT_EQ(queue.pop(tmp), false);
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(i);
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(queue.pop(tmp), true);
+        EXPECT_EQ(tmp, i);
+    }
+    EXPECT_EQ(queue.pop(tmp), false);
+}
+
+TEST(lock_free_segment_queue, recycle_segment)
+{
+    mlts::lock_free_segment_queue<int, 4> queue{};
+    int tmp{};
+    for (int round = 0; round < 1000; ++round)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            queue.push(i);
+        }
+        for (int i = 0; i < 6; ++i)
+        {
+            EXPECT_EQ(queue.pop(tmp), true);
+            EXPECT_EQ(tmp, i);
+        }
+    }
+    EXPECT_LE(queue.segment_count(), 4);
+}
+
+TEST(lock_free_segment_queue, destroy_left_values)
+{
+    auto val = std::make_shared<std::string>("left");
+    {
+        mlts::lock_free_segment_queue<std::shared_ptr<std::string>, 4> queue{};
+        for (int i = 0; i < 10; ++i)
+        {
+            queue.push(val);
+        }
+        std::shared_ptr<std::string> tmp{};
+        queue.pop(tmp);
+        EXPECT_EQ(val.use_count(), 11);
+    }
+    EXPECT_EQ(val.use_count(), 1);
+}
+
+TEST(lock_free_segment_queue, mul_producer_mul_consumer)
+{
+    mlts::lock_free_segment_queue<std::int64_t> queue{};
+    constexpr int push_th_size = 4;
+    constexpr int pop_th_size = 4;
+    constexpr int push_loop_size = 100000;
+    constexpr std::int64_t total_size = push_th_size * push_loop_size;
+    std::atomic<std::int64_t> res{};
+    std::atomic<std::int64_t> pop_count{};
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < push_th_size; ++i)
+        {
+            threads.emplace_back([&queue]() {
+                for (int j = 0; j < push_loop_size; ++j)
+                {
+                    queue.push(j);
+                }
+            });
+        }
+        for (int i = 0; i < pop_th_size; ++i)
+        {
+            threads.emplace_back([&queue, &res, &pop_count]() {
+                std::int64_t local{};
+                while (pop_count.load(std::memory_order_relaxed) < total_size)
+                {
+                    std::int64_t tmp{};
+                    if (queue.pop(tmp))
+                    {
+                        local += tmp;
+                        pop_count.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                res.fetch_add(local);
+            });
+        }
+    }
+    std::int64_t real_res{};
+    for (int j = 0; j < push_loop_size; ++j)
+    {
+        real_res += j;
+    }
+    EXPECT_EQ(res.load(), real_res * push_th_size);
+    std::int64_t tmp{};
+    EXPECT_EQ(queue.pop(tmp), false);
+}
+
+namespace
+{
+// throws when constructed from a multiple of 7
+struct picky
+{
+    picky() = default;
+
+    picky(int v) : m_v(v)
+    {
+        if (v % 7 == 0)
+        {
+            throw std::runtime_error("picky");
+        }
+    }
+
+    int m_v{};
+};
+}
+
+TEST(lock_free_segment_queue, throwing_constructor_skipped)
+{
+    mlts::lock_free_segment_queue<picky, 4> queue{};
+    for (int i = 1; i <= 20; ++i)
+    {
+        if (i % 7 == 0)
+        {
+            EXPECT_THROW(queue.push(i), std::runtime_error);
+        }
+        else
+        {
+            queue.push(i);
+        }
+    }
+    picky tmp{};
+    for (int i = 1; i <= 20; ++i)
+    {
+        if (i % 7 != 0)
+        {
+            EXPECT_EQ(queue.pop(tmp), true);
+            EXPECT_EQ(tmp.m_v, i);
+        }
+    }
+    // the abandoned cells are consumed without handing out a value
+    EXPECT_EQ(queue.pop(tmp), false);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(lock_free_segment_queue, mul_thread_recycle_small_segments)
+{
+    mlts::lock_free_segment_queue<picky, 4> queue{};
+    constexpr int push_th_size = 4;
+    constexpr int pop_th_size = 4;
+    constexpr int push_loop_size = 20000;
+    std::atomic<std::int64_t> res{};
+    std::atomic<std::int64_t> pushed{};
+    std::atomic<int> push_done{};
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < push_th_size; ++i)
+        {
+            threads.emplace_back([&]() {
+                std::int64_t local{};
+                for (int j = 0; j < push_loop_size; ++j)
+                {
+                    try
+                    {
+                        queue.push(j);
+                        local += j;
+                    }
+                    catch (const std::runtime_error&)
+                    {
+                    }
+                }
+                pushed.fetch_add(local);
+                push_done.fetch_add(1);
+            });
+        }
+        for (int i = 0; i < pop_th_size; ++i)
+        {
+            threads.emplace_back([&]() {
+                std::int64_t local{};
+                picky tmp{};
+                while (1)
+                {
+                    bool done = push_done.load() == push_th_size;
+                    if (queue.pop(tmp))
+                    {
+                        local += tmp.m_v;
+                    }
+                    else if (done)
+                    {
+                        break;
+                    }
+                }
+                res.fetch_add(local);
+            });
+        }
+    }
+    EXPECT_EQ(res.load(), pushed.load());
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(lock_free_segment_queue, mul_thread_push_back_cmp_res)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 16;
+    mlts::lock_free_segment_queue<int> queue{};
+    std::mutex mutex{};
+    std::queue<int> normal_queue{};
+    mlts::timer ti{};
+
+    ti.start();
+    {
+        std::vector<std::jthread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&queue]() {
+                for (int j = 0; j < max_int; ++j)
+                {
+                    queue.push(j);
+                }
+            });
+        }
+    }
+    ti.end();
+    auto free_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        std::vector<std::jthread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&mutex, &normal_queue]() {
+                for (int j = 0; j < max_int; ++j)
+                {
+                    std::scoped_lock lk(mutex);
+                    normal_queue.push(j);
+                }
+            });
+        }
+    }
+    ti.end();
+    auto normal_time = ti.elapsed_time();
+
+    std::int64_t free_res{};
+    int tmp{};
+    while (queue.pop(tmp))
+    {
+        free_res += tmp;
+    }
+    std::int64_t normal_res{};
+    while (not normal_queue.empty())
+    {
+        normal_res += normal_queue.front();
+        normal_queue.pop();
+    }
+    std::stringstream ss{};
+    ss << "normal " << normal_time << " segment " << free_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_EQ(free_res, normal_res);
+}
+
+TEST(lock_free_segment_queue, thread_pool_queue)
+{
+    using task_type = mlts::function<void(), mlts::k_thread_pool_task_size>;
+    mlts::thread_pool<task_type, mlts::lock_free_segment_queue<task_type>> tp(2, 1000);
+    std::atomic<int> count{};
+    for (int i = 0; i < 1000; ++i)
+    {
+        tp.push_func([&count]() { count.fetch_add(1); });
+    }
+    tp.shutdown();
+    EXPECT_EQ(count.load(), 1000);
+}
+
+TEST(lock_free_segment_queue, size_approx_and_stats)
+{
+    mlts::lock_free_segment_queue<int, 4> queue{};
+    EXPECT_TRUE(queue.empty());
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.size_approx(), 10);
+    int val{};
+    for (int i = 0; i < 6; ++i)
+    {
+        queue.pop(val);
+    }
+    EXPECT_EQ(queue.size_approx(), 4);
+    auto stats = queue.stats();
+    EXPECT_EQ(stats.m_enqueued, 10);
+    EXPECT_EQ(stats.m_dequeued, 6);
+    EXPECT_EQ(stats.m_high_water, mlts::detail::queue_high_water::enabled() ? 10 : 0);
+}
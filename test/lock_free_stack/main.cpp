@@ -0,0 +1,189 @@
+#include "mlts/lock_free_stack.hpp"
+#include "mlts/timer.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+struct test_item
+{
+    int m_value{};
+    mlts::lock_free_stack_hook m_hook{};
+};
+
+using stack_type = mlts::lock_free_stack<test_item, &test_item::m_hook>;
+
+TEST(lock_free_stack, push_pop)
+{
+    stack_type stack{};
+    std::vector<test_item> items(5);
+    EXPECT_TRUE(stack.empty());
+    EXPECT_EQ(stack.pop(), nullptr);
+    for (int i = 0; i < 5; ++i)
+    {
+        items[i].m_value = i;
+        stack.push(items[i]);
+    }
+    EXPECT_FALSE(stack.empty());
+    for (int i = 4; i >= 0; --i)
+    {
+        test_item* item = stack.pop();
+        ASSERT_NE(item, nullptr);
+        EXPECT_EQ(item->m_value, i);
+    }
+    EXPECT_EQ(stack.pop(), nullptr);
+}
+
+TEST(lock_free_stack, push_chain_pop_all)
+{
+    stack_type stack{};
+    std::vector<test_item> items(6);
+    for (int i = 0; i < 6; ++i)
+    {
+        items[i].m_value = i;
+    }
+    stack.push(items[0]);
+    // 3 -> 2 -> 1 pushed with one CAS
+    stack_type::link(items[3], items[2]);
+    stack_type::link(items[2], items[1]);
+    stack.push_chain(items[3], items[1]);
+    EXPECT_EQ(stack.pop()->m_value, 3);
+
+    std::vector<int> values{};
+    for (test_item* item = stack.pop_all(); item; item = stack_type::next(*item))
+    {
+        values.push_back(item->m_value);
+    }
+    EXPECT_EQ(values, (std::vector<int>{2, 1, 0}));
+    EXPECT_TRUE(stack.empty());
+    EXPECT_EQ(stack.pop_all(), nullptr);
+}
+
+TEST(lock_free_stack, mul_thread_free_list)
+{
+    // every thread takes an item, bumps it and gives it back, the pool is shared by all threads
+    constexpr int pool_size{64};
+    constexpr int thread_size{8};
+    constexpr int loop{100000};
+    std::vector<test_item> items(pool_size);
+    stack_type stack{};
+    for (auto& item : items)
+    {
+        stack.push(item);
+    }
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < thread_size; ++i)
+    {
+        threads.emplace_back([&stack]() {
+            for (int j = 0; j < loop;)
+            {
+                test_item* item = stack.pop();
+                if (item == nullptr)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                ++item->m_value;
+                stack.push(*item);
+                ++j;
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    std::int64_t sum{};
+    int count{};
+    for (test_item* item = stack.pop_all(); item; item = stack_type::next(*item))
+    {
+        sum += item->m_value;
+        ++count;
+    }
+    EXPECT_EQ(count, pool_size);
+    EXPECT_EQ(sum, std::int64_t{loop} * thread_size);
+}
+
+TEST(lock_free_stack, mul_thread_cmp_mutex)
+{
+    constexpr int pool_size{64};
+    constexpr int thread_size{8};
+    constexpr int loop{100000};
+    std::vector<test_item> items(pool_size);
+    mlts::timer ti{};
+
+    stack_type stack{};
+    for (auto& item : items)
+    {
+        stack.push(item);
+    }
+    ti.start();
+    {
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&stack]() {
+                for (int j = 0; j < loop; ++j)
+                {
+                    test_item* item = stack.pop();
+                    if (item)
+                    {
+                        stack.push(*item);
+                    }
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto free_time = ti.elapsed_time();
+
+    std::mutex mutex{};
+    std::vector<test_item*> normal_stack{};
+    for (auto& item : items)
+    {
+        normal_stack.push_back(&item);
+    }
+    ti.start();
+    {
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < thread_size; ++i)
+        {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < loop; ++j)
+                {
+                    test_item* item{};
+                    {
+                        std::scoped_lock lk(mutex);
+                        if (not normal_stack.empty())
+                        {
+                            item = normal_stack.back();
+                            normal_stack.pop_back();
+                        }
+                    }
+                    if (item)
+                    {
+                        std::scoped_lock lk(mutex);
+                        normal_stack.push_back(item);
+                    }
+                }
+            });
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto normal_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "normal " << normal_time << " free " << free_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
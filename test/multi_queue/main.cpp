@@ -0,0 +1,213 @@
+#include "mlts/multi_queue.hpp"
+#include "mlts/timer.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+TEST(multi_queue, single_heap_is_exact)
+{
+    mlts::multi_queue<int> queue{1};
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.try_pop().has_value());
+    for (int v : {5, 1, 9, 3, 7})
+    {
+        queue.push(v);
+    }
+    EXPECT_EQ(queue.size_approx(), 5);
+    for (int v : {9, 7, 5, 3, 1})
+    {
+        EXPECT_EQ(*queue.try_pop(), v);
+    }
+    EXPECT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(multi_queue, greater_pops_smallest)
+{
+    mlts::multi_queue<int, std::greater<int>> queue{1};
+    for (int v : {5, 1, 9})
+    {
+        queue.push(v);
+    }
+    EXPECT_EQ(*queue.try_pop(), 1);
+    EXPECT_EQ(*queue.try_pop(), 5);
+    EXPECT_EQ(*queue.try_pop(), 9);
+}
+
+static bool s_compare_throws{false};
+
+struct throwing_less
+{
+    bool operator()(int a, int b) const
+    {
+        if (s_compare_throws)
+        {
+            throw std::runtime_error("compare");
+        }
+        return a < b;
+    }
+};
+
+TEST(multi_queue, throwing_compare_unlocks_heap)
+{
+    mlts::multi_queue<int, throwing_less> queue{1};
+    for (int v : {5, 1, 9})
+    {
+        queue.push(v);
+    }
+    s_compare_throws = true;
+    EXPECT_THROW(queue.push(7), std::runtime_error);
+    s_compare_throws = false;
+    // the failed push left neither its value nor a broken order behind
+    EXPECT_EQ(queue.size_approx(), 3);
+    for (int v : {9, 5, 1})
+    {
+        EXPECT_EQ(*queue.try_pop(), v);
+    }
+
+    for (int v : {5, 1, 9})
+    {
+        queue.push(v);
+    }
+    s_compare_throws = true;
+    EXPECT_THROW(queue.try_pop(), std::runtime_error);
+    s_compare_throws = false;
+    // a heap left locked would spin here forever
+    queue.push(10);
+    EXPECT_EQ(*queue.try_pop(), 10);
+    EXPECT_TRUE(queue.try_pop().has_value());
+}
+
+TEST(multi_queue, every_value_once)
+{
+    constexpr int max_int{10000};
+    mlts::multi_queue<int> queue{16};
+    EXPECT_EQ(queue.heap_count(), 16);
+    for (int i = 0; i < max_int; ++i)
+    {
+        queue.push(i);
+    }
+    std::vector<int> out{};
+    int v{};
+    while (queue.try_pop(v))
+    {
+        out.push_back(v);
+    }
+    EXPECT_TRUE(queue.empty());
+    ASSERT_EQ(out.size(), max_int);
+    // relaxed, but the first pops still come from the top of the range
+    EXPECT_GT(out.front(), max_int / 2);
+    std::sort(out.begin(), out.end());
+    for (int i = 0; i < max_int; ++i)
+    {
+        EXPECT_EQ(out[i], i);
+    }
+}
+
+TEST(multi_queue, mul_thread)
+{
+    constexpr int max_int{100000};
+    constexpr int thread_size = 4;
+    mlts::multi_queue<int> queue{thread_size * 2};
+    std::atomic<std::int64_t> res{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&queue, t]() {
+            for (int i = t; i < max_int; i += thread_size)
+            {
+                queue.push(i);
+            }
+        });
+        threads.emplace_back([&queue, &res, &popped]() {
+            int v{};
+            while (popped.load(std::memory_order_relaxed) < max_int)
+            {
+                if (queue.try_pop(v))
+                {
+                    res += v;
+                    ++popped;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(popped.load(), max_int);
+    EXPECT_EQ(res.load(), std::int64_t{max_int} * (max_int - 1) / 2);
+    EXPECT_TRUE(queue.empty());
+}
+
+template<typename F>
+static std::chrono::milliseconds run_mixed(int thread_size, int ops, F&& op)
+{
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        threads.emplace_back([&op, t, ops]() {
+            for (int i = 0; i < ops; ++i)
+            {
+                op((i * 7919 + t) % 100000, i & 1);
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    ti.end();
+    return ti.elapsed_time();
+}
+
+TEST(multi_queue, scaling_cmp_locked_priority_queue)
+{
+    constexpr int ops{200000};
+    std::stringstream ss{};
+    for (int thread_size : {1, 2, 4, 8})
+    {
+        mlts::multi_queue<int> queue{};
+        for (int i = 0; i < 1000; ++i)
+        {
+            queue.push(i);
+        }
+        auto multi_time = run_mixed(thread_size, ops, [&queue](int v, bool pop) {
+            int out{};
+            pop ? (void)queue.try_pop(out) : queue.push(v);
+        });
+
+        std::mutex mu{};
+        std::priority_queue<int> locked{};
+        for (int i = 0; i < 1000; ++i)
+        {
+            locked.push(i);
+        }
+        auto locked_time = run_mixed(thread_size, ops, [&mu, &locked](int v, bool pop) {
+            std::scoped_lock lk(mu);
+            if (not pop)
+            {
+                locked.push(v);
+            }
+            else if (not locked.empty())
+            {
+                locked.pop();
+            }
+        });
+        ss << thread_size << " threads, " << ops << " ops each: multi_queue " << multi_time
+           << " locked priority_queue " << locked_time << "\n";
+    }
+    fprintf(stdout, "%s", ss.str().c_str());
+}
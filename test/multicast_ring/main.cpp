@@ -0,0 +1,219 @@
+#include "mlts/atomic_ring_buffer.hpp"
+#include "mlts/multicast_ring.hpp"
+#include "mlts/timer.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+struct market_event
+{
+    std::int64_t m_price{};
+    bool m_journaled{false};
+    bool m_replicated{false};
+};
+
+TEST(multicast_ring, every_consumer_sees_every_event)
+{
+    mlts::multicast_ring<market_event> ring{8};
+    auto& first = ring.add_consumer();
+    auto& second = ring.add_consumer();
+    EXPECT_EQ(ring.cursor(), -1);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(ring.publish_event([i](market_event& e) { e.m_price = i; }), i);
+    }
+    EXPECT_EQ(ring.cursor(), 2);
+
+    std::vector<std::int64_t> seen{};
+    std::vector<bool> end_of_batch{};
+    EXPECT_EQ(first.try_process([&](market_event& e, std::int64_t seq, bool end) {
+        EXPECT_EQ(e.m_price, seq);
+        seen.push_back(e.m_price);
+        end_of_batch.push_back(end);
+    }),
+              3);
+    EXPECT_EQ(seen, (std::vector<std::int64_t>{0, 1, 2}));
+    EXPECT_EQ(end_of_batch, (std::vector<bool>{false, false, true}));
+    EXPECT_EQ(first.try_process([](market_event&, std::int64_t, bool) {}), 0);
+    EXPECT_EQ(first.sequence(), 2);
+
+    seen.clear();
+    EXPECT_EQ(second.try_process([&](market_event& e, std::int64_t, bool) { seen.push_back(e.m_price); }), 3);
+    EXPECT_EQ(seen, (std::vector<std::int64_t>{0, 1, 2}));
+}
+
+TEST(multicast_ring, dependent_consumer_waits_for_its_deps)
+{
+    mlts::multicast_ring<market_event> ring{8};
+    auto& journal = ring.add_consumer();
+    auto& replicate = ring.add_consumer();
+    auto& business = ring.add_consumer({&journal, &replicate});
+    ring.publish_event([](market_event& e) { e.m_price = 42; });
+
+    auto noop = [](market_event&, std::int64_t, bool) {};
+    EXPECT_EQ(business.try_process(noop), 0);
+    journal.try_process([](market_event& e, std::int64_t, bool) { e.m_journaled = true; });
+    EXPECT_EQ(business.try_process(noop), 0);
+    replicate.try_process([](market_event& e, std::int64_t, bool) { e.m_replicated = true; });
+    EXPECT_EQ(business.try_process([](market_event& e, std::int64_t, bool) {
+        EXPECT_TRUE(e.m_journaled);
+        EXPECT_TRUE(e.m_replicated);
+    }),
+              1);
+}
+
+template<typename Wait>
+static void run_graph(int max_int)
+{
+    mlts::multicast_ring<market_event, Wait> ring{64};
+    auto& journal = ring.add_consumer();
+    auto& replicate = ring.add_consumer();
+    auto& business = ring.add_consumer({&journal, &replicate});
+    std::int64_t journal_sum{};
+    std::int64_t replicate_sum{};
+    std::int64_t business_sum{};
+    bool business_ok{true};
+
+    std::vector<std::thread> threads{};
+    threads.emplace_back([&]() {
+        while (journal.process([&](market_event& e, std::int64_t, bool) {
+            journal_sum += e.m_price;
+            e.m_journaled = true;
+        }))
+        {
+        }
+    });
+    threads.emplace_back([&]() {
+        while (replicate.process([&](market_event& e, std::int64_t, bool) {
+            replicate_sum += e.m_price;
+            e.m_replicated = true;
+        }))
+        {
+        }
+    });
+    threads.emplace_back([&]() {
+        while (business.process([&](market_event& e, std::int64_t seq, bool) {
+            business_ok = business_ok && e.m_journaled && e.m_replicated && e.m_price == seq;
+            business_sum += e.m_price;
+        }))
+        {
+        }
+    });
+    for (int i = 0; i < max_int; ++i)
+    {
+        ring.publish_event([i](market_event& e) {
+            e.m_price = i;
+            e.m_journaled = false;
+            e.m_replicated = false;
+        });
+    }
+    ring.halt();
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    auto expect = std::int64_t{max_int} * (max_int - 1) / 2;
+    EXPECT_TRUE(business_ok);
+    EXPECT_EQ(journal_sum, expect);
+    EXPECT_EQ(replicate_sum, expect);
+    EXPECT_EQ(business_sum, expect);
+    EXPECT_EQ(business.sequence(), max_int - 1);
+}
+
+TEST(multicast_ring, mul_thread_yielding)
+{
+    run_graph<mlts::yielding_wait>(200000);
+}
+
+TEST(multicast_ring, mul_thread_blocking)
+{
+    run_graph<mlts::blocking_wait>(200000);
+}
+
+TEST(multicast_ring, mul_thread_busy_spin)
+{
+    run_graph<mlts::busy_spin_wait>(std::thread::hardware_concurrency() > 4 ? 200000 : 2000);
+}
+
+TEST(multicast_ring, multicast_cmp_copy_per_consumer)
+{
+    constexpr int max_int{1000000};
+    constexpr int consumer_size{3};
+    mlts::timer ti{};
+
+    ti.start();
+    {
+        mlts::multicast_ring<market_event> ring{4096};
+        std::vector<std::thread> threads{};
+        for (int c = 0; c < consumer_size; ++c)
+        {
+            auto& consumer = ring.add_consumer();
+            threads.emplace_back([&consumer]() {
+                std::int64_t sum{};
+                while (consumer.process([&sum](market_event& e, std::int64_t, bool) { sum += e.m_price; }))
+                {
+                }
+            });
+        }
+        for (int i = 0; i < max_int; ++i)
+        {
+            ring.publish_event([i](market_event& e) { e.m_price = i; });
+        }
+        ring.halt();
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto ring_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        std::vector<std::unique_ptr<mlts::atomic_ring_buffer<market_event>>> buffers{};
+        std::vector<std::thread> threads{};
+        for (int c = 0; c < consumer_size; ++c)
+        {
+            buffers.push_back(std::make_unique<mlts::atomic_ring_buffer<market_event>>(4096));
+            threads.emplace_back([buffer = buffers.back().get()]() {
+                std::int64_t sum{};
+                for (int i = 0; i < max_int;)
+                {
+                    if (auto e = buffer->get_one())
+                    {
+                        sum += e->m_price;
+                        ++i;
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < max_int; ++i)
+        {
+            market_event e{};
+            e.m_price = i;
+            for (auto& buffer : buffers)
+            {
+                while (not buffer->put_one(e))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        for (auto& th : threads)
+        {
+            th.join();
+        }
+    }
+    ti.end();
+    auto copy_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "multicast_ring " << ring_time << " atomic_ring_buffer per consumer " << copy_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -0,0 +1,453 @@
+#include "mlts/atomic_ring_buffer.hpp"
+#include "mlts/lock_free_circular_queue.hpp"
+#include "mlts/lock_free_queue.hpp"
+#include "mlts/lock_free_segment_queue.hpp"
+#include "mlts/spsc_queue.hpp"
+#include "mlts/timer.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+// throughput and latency of every queue behind one adapter interface, results go to stdout as
+// tables. numbers only mean something on a machine with at least as many idle cores as threads
+
+
+constexpr std::size_t k_ring_capacity{4096};
+constexpr std::uint64_t k_popped_flush{256};
+
+// the element moved through the queues, Size bytes with the sequence number in front
+template<std::size_t Size>
+struct payload
+{
+    static_assert(Size >= sizeof(std::uint64_t), "payload holds at least the sequence");
+
+    payload() = default;
+
+    explicit payload(std::uint64_t seq) : m_seq(seq)
+    {
+    }
+
+    std::uint64_t m_seq{0};
+    std::array<std::byte, Size - sizeof(std::uint64_t)> m_pad{};
+};
+
+// every adapter: try_push / try_pop, and which sides allow more than one thread
+template<typename T>
+struct spsc_queue_adapter
+{
+    static constexpr const char* k_name = "spsc_queue";
+    static constexpr bool k_multi_producer = false;
+    static constexpr bool k_multi_consumer = false;
+
+    bool try_push(const T& v)
+    {
+        m_queue.push(v);
+        return true;
+    }
+
+    bool try_pop(T& v)
+    {
+        return m_queue.try_pop(v);
+    }
+
+    mlts::spsc_queue<T> m_queue{};
+};
+
+template<typename T>
+struct atomic_ring_buffer_adapter
+{
+    static constexpr const char* k_name = "atomic_ring_buffer";
+    static constexpr bool k_multi_producer = false;
+    static constexpr bool k_multi_consumer = false;
+
+    bool try_push(const T& v)
+    {
+        return m_queue.put_one(v);
+    }
+
+    bool try_pop(T& v)
+    {
+        auto ret = m_queue.get_one();
+        if (not ret)
+        {
+            return false;
+        }
+        v = *ret;
+        return true;
+    }
+
+    mlts::atomic_ring_buffer<T> m_queue{k_ring_capacity};
+};
+
+template<typename T>
+struct lock_free_queue_adapter
+{
+    static constexpr const char* k_name = "lock_free_queue";
+    static constexpr bool k_multi_producer = true;
+    static constexpr bool k_multi_consumer = false;
+
+    bool try_push(const T& v)
+    {
+        m_queue.push(v);
+        return true;
+    }
+
+    bool try_pop(T& v)
+    {
+        return m_queue.pop(v);
+    }
+
+    mlts::lock_free_queue<T> m_queue{};
+};
+
+template<typename T>
+struct lock_free_circular_queue_adapter
+{
+    static constexpr const char* k_name = "lock_free_circular_queue";
+    static constexpr bool k_multi_producer = true;
+    static constexpr bool k_multi_consumer = true;
+
+    bool try_push(const T& v)
+    {
+        return m_queue.try_push(v);
+    }
+
+    bool try_pop(T& v)
+    {
+        return m_queue.try_pop(v);
+    }
+
+    mlts::lock_free_circular_queue<T, mlts::DynamicSize32> m_queue{k_ring_capacity};
+};
+
+template<typename T>
+struct lock_free_segment_queue_adapter
+{
+    static constexpr const char* k_name = "lock_free_segment_queue";
+    static constexpr bool k_multi_producer = true;
+    static constexpr bool k_multi_consumer = true;
+
+    bool try_push(const T& v)
+    {
+        m_queue.push(v);
+        return true;
+    }
+
+    bool try_pop(T& v)
+    {
+        return m_queue.pop(v);
+    }
+
+    mlts::lock_free_segment_queue<T> m_queue{};
+};
+
+template<typename T>
+struct mutex_queue_adapter
+{
+    static constexpr const char* k_name = "std::mutex + std::queue";
+    static constexpr bool k_multi_producer = true;
+    static constexpr bool k_multi_consumer = true;
+
+    bool try_push(const T& v)
+    {
+        std::scoped_lock lk(m_mu);
+        m_queue.push(v);
+        return true;
+    }
+
+    bool try_pop(T& v)
+    {
+        std::scoped_lock lk(m_mu);
+        if (m_queue.empty())
+        {
+            return false;
+        }
+        v = m_queue.front();
+        m_queue.pop();
+        return true;
+    }
+
+    std::mutex m_mu{};
+    std::queue<T> m_queue{};
+};
+
+template<template<typename> class... Adapters>
+struct adapter_list
+{
+};
+
+using all_adapters = adapter_list<spsc_queue_adapter, atomic_ring_buffer_adapter, lock_free_queue_adapter,
+                                  lock_free_circular_queue_adapter, lock_free_segment_queue_adapter,
+                                  mutex_queue_adapter>;
+
+// pins the calling thread to core % hardware threads, a no-op where affinity is not supported
+static void pin_to_core(unsigned core)
+{
+    auto cores = std::max(1u, std::thread::hardware_concurrency());
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << (core % cores));
+#else
+    (void)cores;
+#endif
+}
+
+// spins first, yields once the other side is clearly not running
+static void backoff(std::uint32_t& spin)
+{
+    if (++spin >= 64)
+    {
+        std::this_thread::yield();
+    }
+}
+
+template<typename Queue, typename T>
+static void push_wait(Queue& q, const T& v)
+{
+    for (std::uint32_t spin = 0; not q.try_push(v);)
+    {
+        backoff(spin);
+    }
+}
+
+template<typename Queue, typename T>
+static void pop_wait(Queue& q, T& v)
+{
+    for (std::uint32_t spin = 0; not q.try_pop(v);)
+    {
+        backoff(spin);
+    }
+}
+
+struct throughput_result
+{
+    double m_mops{0};
+    bool m_checksum_ok{false};
+};
+
+// producers push per_producer elements each, consumers pop until all arrived; the checksum
+// catches lost or duplicated elements
+template<typename Queue, typename T>
+static throughput_result run_throughput(int producers, int consumers, std::uint64_t per_producer)
+{
+    auto q = std::make_unique<Queue>();
+    const std::uint64_t total = per_producer * static_cast<std::uint64_t>(producers);
+    std::atomic<std::uint64_t> popped{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads{};
+    unsigned core{0};
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p, c = core++]() {
+            pin_to_core(c);
+            while (not go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (std::uint64_t i = 0; i < per_producer; ++i)
+            {
+                push_wait(*q, T{i * static_cast<std::uint64_t>(producers) + static_cast<std::uint64_t>(p)});
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&, c = core++]() {
+            pin_to_core(c);
+            while (not go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            std::uint64_t local_sum{0};
+            std::uint64_t local_popped{0};
+            T v{};
+            std::uint32_t spin{0};
+            while (popped.load(std::memory_order_relaxed) < total)
+            {
+                if (q->try_pop(v))
+                {
+                    local_sum += v.m_seq;
+                    spin = 0;
+                    // the shared counter only decides when to stop, keep it off the hot path
+                    if (++local_popped < k_popped_flush)
+                    {
+                        continue;
+                    }
+                }
+                popped.fetch_add(local_popped, std::memory_order_relaxed);
+                local_popped = 0;
+                backoff(spin);
+            }
+            sum.fetch_add(local_sum, std::memory_order_relaxed);
+        });
+    }
+    mlts::timer ti{};
+    ti.start();
+    go.store(true, std::memory_order_release);
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    ti.end();
+    auto us = std::max<std::int64_t>(1, ti.elapsed_time<std::chrono::microseconds>().count());
+    return {static_cast<double>(total) / static_cast<double>(us), sum.load() == total * (total - 1) / 2};
+}
+
+struct latency_result
+{
+    std::vector<std::int64_t> m_percentiles_ns{};
+    std::int64_t m_max_ns{0};
+};
+
+constexpr std::array<double, 4> k_percentiles{50.0, 90.0, 99.0, 99.9};
+
+// two queues, the echo thread sends every element straight back; each sample is one round trip
+// measured on the sender, both threads pinned to different cores when there are two
+template<typename Queue, typename T>
+static latency_result run_ping_pong(int samples, int warmup)
+{
+    auto ping = std::make_unique<Queue>();
+    auto pong = std::make_unique<Queue>();
+    std::vector<std::int64_t> ns{};
+    ns.reserve(samples);
+    std::thread echo([&]() {
+        pin_to_core(1);
+        T v{};
+        for (int i = 0; i < samples + warmup; ++i)
+        {
+            pop_wait(*ping, v);
+            push_wait(*pong, v);
+        }
+    });
+    std::thread sender([&]() {
+        pin_to_core(0);
+        T v{};
+        for (int i = 0; i < samples + warmup; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            push_wait(*ping, T{static_cast<std::uint64_t>(i)});
+            pop_wait(*pong, v);
+            auto rtt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            if (i >= warmup)
+            {
+                ns.push_back(rtt.count());
+            }
+        }
+    });
+    sender.join();
+    echo.join();
+
+    std::sort(ns.begin(), ns.end());
+    latency_result res{};
+    for (double p : k_percentiles)
+    {
+        auto idx = static_cast<std::size_t>(p / 100.0 * static_cast<double>(ns.size() - 1));
+        res.m_percentiles_ns.push_back(ns[idx]);
+    }
+    res.m_max_ns = ns.back();
+    return res;
+}
+
+template<std::size_t Size, template<typename> class... Adapters>
+static void throughput_table(std::stringstream& ss, adapter_list<Adapters...>, int producers, int consumers,
+                             std::uint64_t per_producer)
+{
+    auto row = [&]<template<typename> class Adapter>() {
+        using queue = Adapter<payload<Size>>;
+        if ((producers > 1 && not queue::k_multi_producer) || (consumers > 1 && not queue::k_multi_consumer))
+        {
+            return;
+        }
+        auto res = run_throughput<queue, payload<Size>>(producers, consumers, per_producer);
+        EXPECT_TRUE(res.m_checksum_ok) << queue::k_name;
+        ss << "  " << std::left << std::setw(26) << queue::k_name << std::right << std::setw(10) << std::fixed
+           << std::setprecision(2) << res.m_mops << " Mops/s\n";
+    };
+    ss << producers << "P" << consumers << "C, " << Size << " byte elements\n";
+    (row.template operator()<Adapters>(), ...);
+}
+
+template<std::size_t Size, template<typename> class... Adapters>
+static void latency_table(std::stringstream& ss, adapter_list<Adapters...>, int samples)
+{
+    auto row = [&]<template<typename> class Adapter>() {
+        using queue = Adapter<payload<Size>>;
+        auto res = run_ping_pong<queue, payload<Size>>(samples, samples / 10);
+        ss << "  " << std::left << std::setw(26) << queue::k_name << std::right;
+        for (auto ns : res.m_percentiles_ns)
+        {
+            ss << std::setw(10) << ns;
+        }
+        ss << std::setw(12) << res.m_max_ns << "\n";
+    };
+    ss << "round trip ns, " << Size << " byte elements\n  " << std::left << std::setw(26) << "queue" << std::right;
+    for (double p : k_percentiles)
+    {
+        std::stringstream label{};
+        label << "p" << p;
+        ss << std::setw(10) << label.str();
+    }
+    ss << std::setw(12) << "max" << "\n";
+    (row.template operator()<Adapters>(), ...);
+}
+
+constexpr std::uint64_t k_elements{200000};
+constexpr int k_multi_threads{4};
+
+TEST(queue_bench, throughput_1p1c)
+{
+    std::stringstream ss{};
+    throughput_table<8>(ss, all_adapters{}, 1, 1, k_elements);
+    throughput_table<64>(ss, all_adapters{}, 1, 1, k_elements);
+    throughput_table<256>(ss, all_adapters{}, 1, 1, k_elements);
+    fprintf(stdout, "%s", ss.str().c_str());
+}
+
+TEST(queue_bench, throughput_np1c)
+{
+    std::stringstream ss{};
+    throughput_table<8>(ss, all_adapters{}, k_multi_threads, 1, k_elements / k_multi_threads);
+    throughput_table<64>(ss, all_adapters{}, k_multi_threads, 1, k_elements / k_multi_threads);
+    throughput_table<256>(ss, all_adapters{}, k_multi_threads, 1, k_elements / k_multi_threads);
+    fprintf(stdout, "%s", ss.str().c_str());
+}
+
+TEST(queue_bench, throughput_npmc)
+{
+    std::stringstream ss{};
+    throughput_table<8>(ss, all_adapters{}, k_multi_threads, k_multi_threads, k_elements / k_multi_threads);
+    throughput_table<64>(ss, all_adapters{}, k_multi_threads, k_multi_threads, k_elements / k_multi_threads);
+    throughput_table<256>(ss, all_adapters{}, k_multi_threads, k_multi_threads, k_elements / k_multi_threads);
+    fprintf(stdout, "%s", ss.str().c_str());
+}
+
+TEST(queue_bench, ping_pong_latency)
+{
+    constexpr int samples{20000};
+    std::stringstream ss{};
+    latency_table<8>(ss, all_adapters{}, samples);
+    latency_table<64>(ss, all_adapters{}, samples);
+    latency_table<256>(ss, all_adapters{}, samples);
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -0,0 +1,293 @@
+#include "mlts/rcu_cell.hpp"
+#include "mlts/seqlock.hpp"
+#include "mlts/timer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <map>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// every field equal, a reader seeing two different fields saw a torn write
+struct route
+{
+    std::uint64_t m_a;
+    std::uint64_t m_b;
+    std::uint32_t m_c;
+    std::uint16_t m_d;
+};
+
+static bool consistent(const route& r)
+{
+    return r.m_a == r.m_b && static_cast<std::uint32_t>(r.m_a) == r.m_c &&
+           static_cast<std::uint16_t>(r.m_a) == r.m_d;
+}
+
+static route make_route(std::uint64_t v)
+{
+    return {v, v, static_cast<std::uint32_t>(v), static_cast<std::uint16_t>(v)};
+}
+
+TEST(seqlock, store_load_update)
+{
+    mlts::seqlock<route> lock{make_route(1)};
+    EXPECT_EQ(lock.load().m_b, 1);
+    EXPECT_EQ(lock.sequence(), 0);
+    lock.store(make_route(2));
+    EXPECT_EQ(lock.load().m_c, 2);
+    EXPECT_EQ(lock.sequence(), 2);
+    lock.update([](route& r) { r = make_route(r.m_a + 1); });
+    route r{};
+    EXPECT_TRUE(lock.try_load(r));
+    EXPECT_EQ(r.m_d, 3);
+    EXPECT_THROW(lock.update([](route&) { throw std::runtime_error("abort"); }), std::runtime_error);
+    // a throwing update leaves the sequence even and the value untouched
+    EXPECT_EQ(lock.sequence(), 4);
+    EXPECT_EQ(lock.load().m_a, 3);
+}
+
+TEST(seqlock, mul_thread_no_torn_reads)
+{
+    constexpr int loop{200000};
+    mlts::seqlock<route> lock{make_route(0)};
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers{};
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&]() {
+            std::uint64_t last{0};
+            while (not stop.load(std::memory_order_relaxed))
+            {
+                auto r = lock.load();
+                // values only grow, each reader sees them in order
+                if (not consistent(r) || r.m_a < last)
+                {
+                    bad.fetch_add(1);
+                }
+                last = r.m_a;
+            }
+        });
+    }
+    std::vector<std::thread> writers{};
+    for (int i = 0; i < 2; ++i)
+    {
+        writers.emplace_back([&]() {
+            for (int j = 0; j < loop; ++j)
+            {
+                lock.update([](route& r) { r = make_route(r.m_a + 1); });
+            }
+        });
+    }
+    for (auto& th : writers)
+    {
+        th.join();
+    }
+    stop = true;
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    EXPECT_EQ(lock.load().m_a, 2 * loop);
+}
+
+static std::atomic<int> s_alive{0};
+
+struct tracked_table
+{
+    tracked_table()
+    {
+        s_alive.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    tracked_table(const tracked_table& other) : m_routes(other.m_routes)
+    {
+        s_alive.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~tracked_table()
+    {
+        s_alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::map<std::string, int> m_routes{};
+};
+
+TEST(rcu_cell, read_update_store)
+{
+    s_alive = 0;
+    {
+        mlts::epoch_domain domain{};
+        {
+            mlts::rcu_cell<tracked_table> cell{tracked_table{}, domain};
+            cell.update([](tracked_table& t) { t.m_routes["a"] = 1; });
+            EXPECT_EQ(cell.read([](const tracked_table& t) { return t.m_routes.at("a"); }), 1);
+            {
+                // a reference result is copied out before the guard is left
+                auto copy = cell.read([](const tracked_table& t) -> const tracked_table& { return t; });
+                static_assert(std::is_same_v<decltype(copy), tracked_table>);
+                EXPECT_EQ(copy.m_routes.at("a"), 1);
+            }
+            EXPECT_THROW(cell.update([](tracked_table&) { throw std::runtime_error("abort"); }), std::runtime_error);
+            EXPECT_EQ(cell.load().m_routes.size(), 1);
+            cell.store(tracked_table{});
+            EXPECT_TRUE(cell.read([](const tracked_table& t) { return t.m_routes.empty(); }));
+            // the replaced values wait for the domain, nobody is inside a guard so a pass frees them
+            for (int i = 0; i < 3; ++i)
+            {
+                domain.quiescent();
+            }
+            EXPECT_EQ(domain.pending(), 0);
+            EXPECT_EQ(s_alive.load(), 1);
+        }
+        EXPECT_EQ(s_alive.load(), 0);
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+TEST(rcu_cell, mul_thread_readers_see_whole_tables)
+{
+    constexpr int loop{20000};
+    mlts::epoch_domain domain{};
+    // every table maps each of its keys to the same generation
+    mlts::rcu_cell<std::map<int, int>> cell{std::map<int, int>{{0, 0}, {1, 0}, {2, 0}}, domain};
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers{};
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&]() {
+            while (not stop.load(std::memory_order_relaxed))
+            {
+                cell.read([&bad](const std::map<int, int>& m) {
+                    for (auto& [k, v] : m)
+                    {
+                        if (v != m.begin()->second)
+                        {
+                            bad.fetch_add(1);
+                        }
+                    }
+                });
+                mlts::quiescent_state();
+            }
+        });
+    }
+    std::thread writer([&]() {
+        for (int j = 1; j <= loop; ++j)
+        {
+            cell.update([j](std::map<int, int>& m) {
+                for (auto& [k, v] : m)
+                {
+                    v = j;
+                }
+                m[j % 16] = j;
+            });
+            mlts::quiescent_state();
+        }
+    });
+    writer.join();
+    stop = true;
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    EXPECT_EQ(cell.load().at(0), loop);
+}
+
+// the reader-count lock the cells replace
+template<typename T>
+class shared_mutex_cell
+{
+public:
+    template<typename F>
+    decltype(auto) read(F&& f) const
+    {
+        std::shared_lock lk(m_mu);
+        return f(std::as_const(m_value));
+    }
+
+    template<typename F>
+    void update(F&& f)
+    {
+        std::unique_lock lk(m_mu);
+        f(m_value);
+    }
+
+private:
+    mutable std::shared_mutex m_mu{};
+    T m_value{};
+};
+
+// reader threads read as fast as they can while one writer updates every 100us
+template<typename Read, typename Update>
+static std::chrono::milliseconds run_readers(int thread_size, int reads, Read&& read, Update&& update)
+{
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        while (not stop.load(std::memory_order_relaxed))
+        {
+            update();
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    mlts::timer ti{};
+    ti.start();
+    std::vector<std::thread> readers{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        readers.emplace_back([&read, reads]() {
+            // the writer only counts up, a reader never sees an older value after a newer one
+            std::uint64_t last{0};
+            int regressions{0};
+            for (int i = 0; i < reads; ++i)
+            {
+                std::uint64_t v = read();
+                regressions += v < last;
+                last = v;
+            }
+            EXPECT_EQ(regressions, 0);
+        });
+    }
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+    ti.end();
+    stop = true;
+    writer.join();
+    return ti.elapsed_time();
+}
+
+TEST(read_mostly, readers_cmp_shared_mutex)
+{
+    constexpr int reads{2000000};
+    std::stringstream ss{};
+    for (int thread_size : {1, 2, 4, 8})
+    {
+        mlts::seqlock<route> lock{make_route(0)};
+        auto seqlock_time = run_readers(
+            thread_size, reads / thread_size, [&lock]() { return lock.load().m_a; },
+            [&lock]() { lock.update([](route& r) { r = make_route(r.m_a + 1); }); });
+
+        mlts::rcu_cell<route> cell{make_route(0)};
+        auto rcu_time = run_readers(
+            thread_size, reads / thread_size, [&cell]() { return cell.read([](const route& r) { return r.m_a; }); },
+            [&cell]() { cell.update([](route& r) { r = make_route(r.m_a + 1); }); });
+
+        shared_mutex_cell<route> locked{};
+        auto locked_time = run_readers(
+            thread_size, reads / thread_size, [&locked]() { return locked.read([](const route& r) { return r.m_a; }); },
+            [&locked]() { locked.update([](route& r) { r = make_route(r.m_a + 1); }); });
+
+        ss << thread_size << " readers: seqlock " << seqlock_time << " rcu_cell " << rcu_time << " shared_mutex "
+           << locked_time << "\n";
+    }
+    fprintf(stdout, "%s", ss.str().c_str());
+}
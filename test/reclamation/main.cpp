@@ -0,0 +1,305 @@
+#include "mlts/epoch_domain.hpp"
+#include "mlts/hazard_domain.hpp"
+#include "mlts/thread_pool.hpp"
+#include "mlts/timer.hpp"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+static std::atomic<int> s_alive{0};
+
+struct tracked
+{
+    explicit tracked(int value) : m_value(value)
+    {
+        s_alive.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~tracked()
+    {
+        // a reader seeing this value read freed memory
+        m_value = -1;
+        s_alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    int m_value;
+};
+
+TEST(epoch_domain, retire_waits_for_guard)
+{
+    s_alive = 0;
+    {
+        mlts::epoch_domain domain{};
+        std::atomic<bool> entered{false};
+        std::atomic<bool> release{false};
+        std::thread reader([&]() {
+            mlts::epoch_domain::guard g(domain);
+            entered = true;
+            while (not release)
+            {
+                std::this_thread::yield();
+            }
+        });
+        while (not entered)
+        {
+            std::this_thread::yield();
+        }
+        domain.retire(new tracked(1));
+        for (int i = 0; i < 10; ++i)
+        {
+            domain.quiescent();
+        }
+        // the reader entered before the retire and is still inside
+        EXPECT_EQ(s_alive.load(), 1);
+        EXPECT_EQ(domain.pending(), 1);
+        release = true;
+        reader.join();
+        for (int i = 0; i < 3; ++i)
+        {
+            domain.quiescent();
+        }
+        EXPECT_EQ(s_alive.load(), 0);
+        EXPECT_EQ(domain.pending(), 0);
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+TEST(epoch_domain, destroy_frees_everything)
+{
+    s_alive = 0;
+    {
+        mlts::epoch_domain domain{};
+        for (int i = 0; i < 100; ++i)
+        {
+            domain.retire(new tracked(i));
+        }
+        std::thread th([&domain]() { domain.retire(new tracked(100)); });
+        th.join();
+        EXPECT_EQ(s_alive.load(), 101);
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+TEST(reclamation, short_lived_domains_release_thread_slots)
+{
+    s_alive = 0;
+    auto& reclaim = mlts::detail::this_thread_reclaim();
+    auto before = reclaim.m_slots.size();
+    for (int i = 0; i < 1000; ++i)
+    {
+        mlts::epoch_domain epoch{};
+        mlts::hazard_domain hazard{};
+        {
+            mlts::epoch_domain::guard g(epoch);
+            mlts::hazard_domain::holder h(hazard);
+        }
+        epoch.retire(new tracked(i));
+        hazard.retire(new tracked(i));
+    }
+    // each new domain drops the slots of the destroyed ones, only the last pair is left
+    EXPECT_LE(reclaim.m_slots.size(), before + 2);
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+template<typename Domain, typename Read>
+void swap_and_read(Domain& domain, Read&& read)
+{
+    constexpr int thread_size{4};
+    constexpr int loop{20000};
+    std::atomic<tracked*> shared{new tracked(0)};
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers{};
+    for (int i = 0; i < thread_size; ++i)
+    {
+        readers.emplace_back([&]() {
+            while (not stop.load(std::memory_order_relaxed))
+            {
+                if (read(shared) < 0)
+                {
+                    bad.fetch_add(1);
+                }
+                mlts::quiescent_state();
+            }
+        });
+    }
+    std::vector<std::thread> writers{};
+    for (int i = 0; i < 2; ++i)
+    {
+        writers.emplace_back([&]() {
+            for (int j = 1; j <= loop; ++j)
+            {
+                tracked* old = shared.exchange(new tracked(j), std::memory_order_acq_rel);
+                domain.retire(old);
+                mlts::quiescent_state();
+            }
+        });
+    }
+    for (auto& th : writers)
+    {
+        th.join();
+    }
+    stop = true;
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+    delete shared.load();
+    EXPECT_EQ(bad.load(), 0);
+}
+
+TEST(epoch_domain, mul_thread_swap_and_read)
+{
+    s_alive = 0;
+    {
+        mlts::epoch_domain domain{};
+        swap_and_read(domain, [&domain](std::atomic<tracked*>& shared) {
+            mlts::epoch_domain::guard g(domain);
+            return shared.load(std::memory_order_acquire)->m_value;
+        });
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+TEST(hazard_domain, protect_pins_object)
+{
+    s_alive = 0;
+    {
+        mlts::hazard_domain domain{};
+        std::atomic<tracked*> shared{new tracked(1)};
+        {
+            mlts::hazard_domain::holder h(domain);
+            tracked* p = h.protect(shared);
+            shared.store(new tracked(2));
+            domain.retire(p);
+            domain.quiescent();
+            EXPECT_EQ(p->m_value, 1);
+            EXPECT_EQ(domain.pending(), 1);
+            h.reset();
+            domain.quiescent();
+            EXPECT_EQ(domain.pending(), 0);
+        }
+        delete shared.load();
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+// freeing a link retires the next one into the same domain
+struct retiring_link
+{
+    ~retiring_link()
+    {
+        if (m_next)
+        {
+            m_domain->retire(m_next);
+        }
+    }
+
+    mlts::hazard_domain* m_domain;
+    retiring_link* m_next;
+    tracked m_value;
+};
+
+TEST(hazard_domain, deleter_retires_into_same_domain)
+{
+    s_alive = 0;
+    {
+        mlts::hazard_domain domain{};
+        retiring_link* chain{nullptr};
+        for (int i = 0; i < 4; ++i)
+        {
+            chain = new retiring_link{&domain, chain, tracked(i)};
+        }
+        domain.retire(chain);
+        // each pass frees one link, its deleter retires the next while the pass is still running
+        for (int i = 0; i < 4; ++i)
+        {
+            EXPECT_EQ(domain.pending(), 1);
+            domain.quiescent();
+        }
+        EXPECT_EQ(domain.pending(), 0);
+        EXPECT_EQ(s_alive.load(), 0);
+    }
+}
+
+TEST(hazard_domain, too_many_holders)
+{
+    mlts::hazard_domain domain{};
+    std::vector<std::unique_ptr<mlts::hazard_domain::holder>> holders{};
+    for (std::size_t i = 0; i < mlts::hazard_domain::k_hazard_size; ++i)
+    {
+        holders.push_back(std::make_unique<mlts::hazard_domain::holder>(domain));
+    }
+    EXPECT_THROW(mlts::hazard_domain::holder extra(domain), std::length_error);
+    holders.pop_back();
+    EXPECT_NO_THROW(mlts::hazard_domain::holder extra(domain));
+}
+
+TEST(hazard_domain, mul_thread_swap_and_read)
+{
+    s_alive = 0;
+    {
+        mlts::hazard_domain domain{};
+        swap_and_read(domain, [&domain](std::atomic<tracked*>& shared) {
+            mlts::hazard_domain::holder h(domain);
+            return h.protect(shared)->m_value;
+        });
+    }
+    EXPECT_EQ(s_alive.load(), 0);
+}
+
+TEST(reclamation, thread_pool_workers_reclaim_between_tasks)
+{
+    s_alive = 0;
+    mlts::epoch_domain domain{};
+    {
+        mlts::thread_pool<> pool{2};
+        constexpr int task_size{20000};
+        for (int i = 0; i < task_size; ++i)
+        {
+            pool.push_func([&domain, i]() { domain.retire(new tracked(i)); });
+        }
+        pool.shutdown(mlts::thread_pool<>::shutdown_mode::drain);
+        // nobody called quiescent explicitly, the workers' hook kept the backlog bounded
+        EXPECT_LT(s_alive.load(), task_size / 2);
+    }
+}
+
+TEST(reclamation, guard_cost)
+{
+    constexpr int loop{1000000};
+    mlts::epoch_domain domain{};
+    mlts::hazard_domain hazards{};
+    std::atomic<tracked*> shared{new tracked(1)};
+    std::int64_t sum{};
+    mlts::timer ti{};
+
+    ti.start();
+    for (int i = 0; i < loop; ++i)
+    {
+        mlts::epoch_domain::guard g(domain);
+        sum += shared.load(std::memory_order_acquire)->m_value;
+    }
+    ti.end();
+    auto epoch_time = ti.elapsed_time<std::chrono::microseconds>();
+
+    ti.start();
+    {
+        mlts::hazard_domain::holder h(hazards);
+        for (int i = 0; i < loop; ++i)
+        {
+            sum += h.protect(shared)->m_value;
+        }
+    }
+    ti.end();
+    auto hazard_time = ti.elapsed_time<std::chrono::microseconds>();
+    delete shared.load();
+
+    std::stringstream ss{};
+    ss << "epoch guard " << epoch_time << " hazard protect " << hazard_time << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+    EXPECT_EQ(sum, 2 * loop);
+}
@@ -8,6 +8,7 @@
 #include <map>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <vector>
 
 template<typename T>
@@ -157,4 +158,32 @@ TEST(ring_buffer, multi_thread)
     t1.join();
     t2.join();
     EXPECT_EQ(sum.load(), sum_res);
-}
\ No newline at end of file
+}
+TEST(ring_buffer, size_approx_and_empty)
+{
+    t_ring_buffer<int> rb{4};
+    EXPECT_TRUE(rb.empty());
+    rb.put({1, 2, 3, 4});
+    EXPECT_FALSE(rb.empty());
+    EXPECT_EQ(rb.size_approx(), 4);
+    rb.get_one();
+    EXPECT_EQ(rb.size_approx(), 3);
+    EXPECT_EQ(rb.stats().m_dequeued, 1);
+}
+
+TEST(ring_buffer, wrap_non_trivial)
+{
+    t_ring_buffer<std::string> rb{4};
+    std::string long_str(64, 'x');
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(rb.put_one(long_str + std::to_string(i)));
+        EXPECT_TRUE(rb.put_one(long_str + std::to_string(i)));
+        EXPECT_TRUE(rb.put_one(long_str + std::to_string(i)));
+        EXPECT_EQ(*rb.get_one(), long_str + std::to_string(i));
+        EXPECT_EQ(*rb.get_one(), long_str + std::to_string(i));
+        EXPECT_EQ(*rb.get_one(), long_str + std::to_string(i));
+    }
+    rb.put({long_str, long_str, long_str});
+    EXPECT_EQ(rb.size_approx(), 3);
+}
@@ -0,0 +1,229 @@
+#include "mlts/atomic_ring_buffer.hpp"
+#include "mlts/lock_free_queue.hpp"
+#include "mlts/spsc_queue.hpp"
+#include "mlts/timer.hpp"
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+TEST(spsc_queue, push_pop_in_order)
+{
+    mlts::spsc_queue<int, 4> queue{};
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.front(), nullptr);
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.size_approx(), 10);
+    EXPECT_EQ(*queue.front(), 0);
+    queue.pop_front();
+    for (int i = 1; i < 10; ++i)
+    {
+        int v{};
+        EXPECT_TRUE(queue.try_pop(v));
+        EXPECT_EQ(v, i);
+    }
+    int v{};
+    EXPECT_FALSE(queue.try_pop(v));
+    EXPECT_TRUE(queue.empty());
+    auto stats = queue.stats();
+    EXPECT_EQ(stats.m_enqueued, 10);
+    EXPECT_EQ(stats.m_dequeued, 10);
+}
+
+TEST(spsc_queue, non_trivial_across_blocks)
+{
+    std::string long_str(64, 'x');
+    auto counter = std::make_shared<int>(0);
+    {
+        mlts::spsc_queue<std::shared_ptr<int>, 2> holders{};
+        mlts::spsc_queue<std::string, 2> queue{};
+        for (int round = 0; round < 10; ++round)
+        {
+            for (int i = 0; i < 5; ++i)
+            {
+                queue.emplace(long_str + std::to_string(i));
+                holders.push(counter);
+            }
+            for (int i = 0; i < 5; ++i)
+            {
+                EXPECT_EQ(*queue.front(), long_str + std::to_string(i));
+                queue.pop_front();
+            }
+            EXPECT_TRUE(queue.empty());
+        }
+        EXPECT_EQ(counter.use_count(), 51);
+        // left in the queue, freed by its destructor
+        queue.push(long_str);
+    }
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+struct throw_on_copy
+{
+    throw_on_copy() = default;
+
+    throw_on_copy(const throw_on_copy& other) : m_value(other.m_value)
+    {
+        if (other.m_throw)
+        {
+            throw std::runtime_error("copy");
+        }
+    }
+
+    int m_value{};
+    bool m_throw{false};
+};
+
+TEST(spsc_queue, throwing_push_leaves_queue_unchanged)
+{
+    mlts::spsc_queue<throw_on_copy, 2> queue{};
+    throw_on_copy ok{};
+    throw_on_copy bad{};
+    bad.m_throw = true;
+    for (int i = 0; i < 5; ++i)
+    {
+        ok.m_value = i;
+        queue.push(ok);
+        EXPECT_THROW(queue.push(bad), std::runtime_error);
+    }
+    EXPECT_EQ(queue.size_approx(), 5);
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(queue.front()->m_value, i);
+        queue.pop_front();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(spsc_queue, mul_thread)
+{
+    constexpr int max_int{1000000};
+    mlts::spsc_queue<int, 64> queue{};
+    std::thread producer([&queue]() {
+        for (int i = 0; i < max_int; ++i)
+        {
+            queue.push(i);
+        }
+    });
+    std::int64_t res{};
+    bool in_order{true};
+    for (int expect = 0; expect < max_int;)
+    {
+        if (int* p = queue.front())
+        {
+            in_order = in_order && *p == expect;
+            res += *p;
+            queue.pop_front();
+            ++expect;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(res, std::int64_t{max_int} * (max_int - 1) / 2);
+}
+
+TEST(spsc_queue, spsc_cmp_ring_buffer_and_lock_free_queue)
+{
+    constexpr int max_int{1000000};
+    mlts::timer ti{};
+
+    ti.start();
+    {
+        mlts::spsc_queue<int> queue{};
+        std::thread producer([&queue]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                queue.push(i);
+            }
+        });
+        int v{};
+        for (int i = 0; i < max_int;)
+        {
+            if (queue.try_pop(v))
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+    }
+    ti.end();
+    auto spsc_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        mlts::atomic_ring_buffer<int> queue{4096};
+        std::thread producer([&queue]() {
+            for (int i = 0; i < max_int;)
+            {
+                if (queue.put_one(i))
+                {
+                    ++i;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (int i = 0; i < max_int;)
+        {
+            if (queue.get_one())
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+    }
+    ti.end();
+    auto ring_time = ti.elapsed_time();
+
+    ti.start();
+    {
+        mlts::lock_free_queue<int> queue{};
+        std::thread producer([&queue]() {
+            for (int i = 0; i < max_int; ++i)
+            {
+                queue.push(i);
+            }
+        });
+        int v{};
+        for (int i = 0; i < max_int;)
+        {
+            if (queue.pop(v))
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+    }
+    ti.end();
+    auto queue_time = ti.elapsed_time();
+
+    std::stringstream ss{};
+    ss << "spsc_queue " << spsc_time << " atomic_ring_buffer " << ring_time << " lock_free_queue " << queue_time
+       << "\n";
+    fprintf(stdout, "%s", ss.str().c_str());
+}
@@ -1,15 +1,58 @@
+#include "mlts/allocator.hpp"
 #include "mlts/lambda_box.hpp"
 #include "mlts/lock_free_queue.hpp"
 #include "mlts/thread_pool.hpp"
 #include "mlts/timer.hpp"
+#include <array>
+#include <atomic>
 #include <fstream>
+#include <future>
 #include <gtest/gtest.h>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <thread>
 #include <vector>
 
 
+namespace
+{
+std::atomic<size_t> s_node_alloc_count{0};
+
+// upstream of the node recycler, counts every node that has to come from the heap
+template<typename T>
+struct counting_allocator
+{
+    using value_type = T;
+
+    counting_allocator() = default;
+
+    template<typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        s_node_alloc_count.fetch_add(1, std::memory_order_relaxed);
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        std::allocator<T>{}.deallocate(p, n);
+    }
+};
+
+struct counting_policy
+{
+    using task_type = typename mlts::thread_pool_policy<>::task_type;
+    using node_type = mlts::lock_free_queue_node<task_type>;
+    using queue_type =
+        mlts::lock_free_queue<task_type, mlts::mp_sc_recycle_allocator<node_type, 64, counting_allocator<node_type>>>;
+};
+}
 
 TEST(thread_pool, push_func)
 {
@@ -127,3 +170,215 @@ TEST(thread_pool, mul_thread_push_func_with_lambda_box)
     tp.wait_done();
     EXPECT_EQ(real_val, right_val);
 }
+
+TEST(thread_pool, task_exception_handler)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    std::atomic<int> handled{};
+    tp.set_exception_handler([&handled](std::exception_ptr e) {
+        try
+        {
+            std::rethrow_exception(e);
+        }
+        catch (const std::runtime_error&)
+        {
+            handled.fetch_add(1);
+        }
+    });
+    int ret{};
+    tp.push_func([]() { throw std::runtime_error("task failed"); });
+    tp.push_func([&ret]() { ret = 4; });
+    tp.wait_done();
+    EXPECT_EQ(ret, 4);
+    EXPECT_EQ(handled.load(), 1);
+    EXPECT_EQ(tp.exception_count(), 1);
+}
+
+TEST(thread_pool, submit_future)
+{
+    mlts::thread_pool<> tp(2, 1000);
+    auto value = tp.submit([]() { return 4; });
+    auto error = tp.submit([]() -> int { throw std::runtime_error("task failed"); });
+    EXPECT_EQ(value.get(), 4);
+    EXPECT_THROW(error.get(), std::runtime_error);
+    EXPECT_EQ(tp.exception_count(), 0);
+}
+
+TEST(thread_pool, shutdown_drain)
+{
+    mlts::thread_pool<> tp(2, 1000);
+    std::atomic<int> count{};
+    for (int i = 0; i < 1000; ++i)
+    {
+        tp.push_func([&count]() { count.fetch_add(1); });
+    }
+    auto report = tp.shutdown(mlts::thread_pool<>::shutdown_mode::drain);
+    EXPECT_EQ(count.load(), 1000);
+    EXPECT_EQ(report.dropped, 0);
+    EXPECT_EQ(report.timeout, false);
+}
+
+TEST(thread_pool, shutdown_abort)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    std::atomic<bool> is_start{false};
+    std::atomic<bool> is_release{false};
+    std::atomic<int> count{};
+    tp.push_func([&is_start, &is_release]() {
+        is_start.store(true);
+        while (not is_release.load())
+        {
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < 100; ++i)
+    {
+        tp.push_func([&count]() { count.fetch_add(1); });
+    }
+    while (not is_start.load())
+    {
+        std::this_thread::yield();
+    }
+    std::thread releaser([&is_release]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        is_release.store(true);
+    });
+    auto report = tp.shutdown(mlts::thread_pool<>::shutdown_mode::abort);
+    releaser.join();
+    EXPECT_EQ(count.load(), 0);
+    EXPECT_EQ(report.dropped, 100);
+}
+
+TEST(thread_pool, shutdown_for_timeout)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    std::atomic<bool> is_start{false};
+    std::atomic<int> count{};
+    tp.push_func([&is_start]() {
+        is_start.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    });
+    for (int i = 0; i < 10; ++i)
+    {
+        tp.push_func([&count]() { count.fetch_add(1); });
+    }
+    while (not is_start.load())
+    {
+        std::this_thread::yield();
+    }
+    auto report = tp.shutdown_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(report.timeout, true);
+    EXPECT_EQ(report.dropped + count.load(), 10);
+    EXPECT_GE(report.elapsed, std::chrono::milliseconds(1));
+}
+
+TEST(thread_pool, push_after_shutdown_rejected)
+{
+    mlts::thread_pool<> tp(2, 1000);
+    std::atomic<int> count{};
+    EXPECT_TRUE(tp.push_func([&count]() { count.fetch_add(1); }));
+    tp.shutdown();
+    EXPECT_TRUE(tp.is_closed());
+    EXPECT_FALSE(tp.push_func([&count]() { count.fetch_add(1); }));
+    EXPECT_FALSE(tp.push_func(1, [&count]() { count.fetch_add(1); }));
+    auto fut = tp.submit([]() { return 4; });
+    EXPECT_THROW(fut.get(), std::future_error);
+    // a second shutdown finds nothing left to drop
+    EXPECT_EQ(tp.shutdown().dropped, 0);
+    EXPECT_EQ(count.load(), 1);
+
+    tp.reset(2);
+    EXPECT_FALSE(tp.is_closed());
+    EXPECT_TRUE(tp.push_func([&count]() { count.fetch_add(1); }));
+    tp.shutdown();
+    EXPECT_EQ(count.load(), 2);
+}
+
+TEST(thread_pool, mul_thread_push_during_shutdown)
+{
+    constexpr int thread_size = 4;
+    mlts::thread_pool<> tp(2, 1000);
+    std::atomic<int> count{};
+    std::atomic<int> accepted{};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pushers{};
+    for (int t = 0; t < thread_size; ++t)
+    {
+        pushers.emplace_back([&]() {
+            while (not go.load())
+            {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < 10000; ++i)
+            {
+                if (tp.push_func([&count]() { count.fetch_add(1); }))
+                {
+                    accepted.fetch_add(1);
+                }
+            }
+        });
+    }
+    go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto report = tp.shutdown();
+    for (auto& th : pushers)
+    {
+        th.join();
+    }
+    // pushes accepted after the workers finished are dropped by the next shutdown
+    report.dropped += tp.shutdown().dropped;
+    EXPECT_EQ(count.load() + static_cast<int>(report.dropped), accepted.load());
+}
+
+TEST(thread_pool, move_only_task)
+{
+    mlts::thread_pool<> tp(1, 1000);
+    auto val = std::make_unique<int>(4);
+    int ret{};
+    tp.push_func([val = std::move(val), &ret]() { ret = *val; });
+    tp.wait_done();
+    EXPECT_EQ(ret, 4);
+}
+
+TEST(thread_pool, custom_policy)
+{
+    using policy = mlts::thread_pool_policy<mlts::function<void(), 96>>;
+    mlts::thread_pool_for<policy> tp(1, 1000);
+    std::array<std::int64_t, 10> values{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    std::int64_t ret{};
+    tp.push_func([values, &ret]() {
+        for (auto v : values)
+        {
+            ret += v;
+        }
+    });
+    tp.wait_done();
+    EXPECT_EQ(ret, 55);
+}
+
+TEST(thread_pool, steady_state_push_no_allocation)
+{
+    constexpr size_t push_size = 4096;
+    mlts::thread_pool_for<counting_policy> tp(1, 1000);
+    std::atomic<std::int64_t> ret{};
+    std::array<std::int64_t, 4> payload{1, 1, 1, 1};
+    auto push_round = [&]() {
+        for (size_t i = 0; i < push_size; ++i)
+        {
+            tp.push_func([payload, &ret]() { ret.fetch_add(payload[0]); });
+            if (i % 32 == 31)
+            {
+                while (ret.load() != static_cast<std::int64_t>(i + 1))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        ret.store(0);
+    };
+    push_round();
+    auto before = s_node_alloc_count.load();
+    push_round();
+    auto allocation = s_node_alloc_count.load() - before;
+    EXPECT_LT(allocation, push_size / 8);
+}